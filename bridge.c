@@ -0,0 +1,125 @@
+/*
+ * bridge.c
+ *
+ * PTX side of the serial bridge (PTX_DEV builds only) runs from UART_RX_EVENT, which
+ * the UART posts for new bytes and bridge_timer posts when the idle time runs out.
+ * With BRIDGE_REPORTS, bridge_stats measure what the coalescing costs: payload fill
+ * (bytes / payloads) against the added latency (wait_total / payloads, wait_max), to be
+ * compared across bridge_set_idle() settings.
+ */
+
+#include <msp430.h>
+#include "bridge.h"
+#include "nrf24api.h"
+#include "interrupts.h"
+#include "events.h"
+#include "timer.h"
+#include "uart.h"
+#include "nrf_userconfig.h"
+#include "log.h"
+
+#if PTX_DEV
+#ifdef BRIDGE_REPORTS
+BRIDGE_STATS bridge_stats;
+#endif
+
+static TIMER bridge_timer = TIMER_EVENT(UART_RX_EVENT);	// idle flush
+
+static uint16_t bridge_idle = BRIDGE_IDLE;
+static uint8_t *bridge_buf = 0;				// pool slot being filled, see radio_stream_buf()
+static uint8_t bridge_len = 0;
+#ifdef BRIDGE_REPORTS
+static uint16_t bridge_first;				// ticks at bridge_buf's first byte
+#endif
+
+// 0 sends whatever the UART has as soon as it is read
+void bridge_set_idle(uint16_t ticks) {
+	bridge_idle = ticks;
+}
+
+static void bridge_flush() {
+#ifdef BRIDGE_REPORTS
+	uint16_t wait = clock_ticks() - bridge_first;
+
+	bridge_stats.bytes += bridge_len;
+	bridge_stats.payloads++;
+	bridge_stats.wait_total += wait;
+	if (wait > bridge_stats.wait_max)
+		bridge_stats.wait_max = wait;
+#endif
+	radio_stream_send(bridge_len);
+	bridge_buf = 0;
+	bridge_len = 0;
+}
+
+/* Move what the UART has into payloads, gathered in place in a pool slot; a full one
+ * goes at once, a partial one once idle.
+ */
+void bridge_poll() {
+	uint8_t n, fresh = 0;
+
+	while (ring_count(&uart_rx)) {
+		if (!bridge_buf && !(bridge_buf = radio_stream_buf())) {
+#ifdef BRIDGE_REPORTS
+			bridge_stats.refused++;
+#endif
+			timer_start(&bridge_timer, 1, 0);  // Pool full, bytes wait in uart_rx; try again next tick
+			return;
+		}
+		n = uart_read(bridge_buf + bridge_len, MSG_CHUNK - bridge_len);
+		if (n) {
+#ifdef BRIDGE_REPORTS
+			if (!bridge_len)
+				bridge_first = clock_ticks();
+#endif
+			bridge_len += n;
+			fresh = 1;
+		}
+		if (bridge_len == MSG_CHUNK)
+			bridge_flush();
+	}
+	if (!bridge_len) {
+		if (bridge_buf)
+			radio_stream_send(0);  // Only rate negotiation bytes came, the slot goes back
+		bridge_buf = 0;
+		return;
+	}
+	if (fresh && bridge_idle)
+		timer_start(&bridge_timer, bridge_idle, 0);  // Idle from now on
+	else if (!timer_armed(&bridge_timer))
+		bridge_flush();
+}
+
+#ifdef BRIDGE_REPORTS
+void bridge_report() {
+	uint16_t avg = bridge_stats.payloads ? bridge_stats.wait_total / bridge_stats.payloads : 0;
+
+	LOG(LOG_BRIDGE, LOG_U32(bridge_stats.bytes), bridge_stats.payloads, avg, bridge_stats.wait_max);
+}
+#endif
+#endif
+
+/* Decode len bytes of a COBS stream in place, returns the decoded length (never more
+ * than len).  Blocks run across calls, so frames may be split over payloads any way.
+ * A 0x00 inside a block means the frame was cut short, decoding resyncs on it.
+ */
+uint8_t cobs_decode(COBS_STATE *s, uint8_t *buf, uint8_t len) {
+	uint8_t in, out = 0, c;
+
+	for (in = 0; in < len; in++) {
+		c = buf[in];
+		if (!c) {  // End of frame
+			s->left = 0;
+			s->zero = 0;
+		} else if (s->left) {
+			buf[out++] = c;
+			s->left--;
+		} else {  // Code byte: the block before it ended in a zero unless it was a full one
+			if (s->zero)
+				buf[out++] = 0;
+			s->left = c - 1;
+			s->zero = c != 0xFF;
+		}
+	}
+	return out;
+}
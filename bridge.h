@@ -0,0 +1,43 @@
+/*
+ * bridge.h
+ *
+ * Transparent serial bridge.  The host frames its data with COBS (0x00 delimited) and
+ * the PTX packs the encoded bytes into radio payloads as they come, several small
+ * frames to a payload.  A payload goes when it is full or the UART has been idle for
+ * bridge_idle timer ticks, so a burst of single bytes doesn't cost a whole ESB frame
+ * each.  The PRX decodes the stream back onto its UART (cobs_decode()).
+ */
+
+#ifndef BRIDGE_H_
+#define BRIDGE_H_
+
+#include <stdint.h>
+#include "interrupts.h"
+
+#define BRIDGE_IDLE			(TICK_HZ / 500)	// default coalescing timeout, timer ticks (2ms)
+#define BRIDGE_REPORT_SECS		10		// BRIDGE_REPORTS: seconds between reports
+
+typedef struct {
+	uint32_t bytes;			// host bytes sent
+	uint16_t payloads;		// radio payloads they took
+	uint16_t refused;		// UART bytes left waiting, packet pool full
+	uint32_t wait_total;	// timer ticks from a payload's first byte to its flush, summed
+	uint16_t wait_max;
+} BRIDGE_STATS;
+
+// Stream decoder state, one per source (pipe)
+typedef struct {
+	uint8_t left;			// data bytes left in the current block
+	uint8_t zero;			// a 0x00 is owed before the next block
+} COBS_STATE;
+
+void bridge_poll();
+void bridge_set_idle(uint16_t ticks);
+void bridge_report();
+uint8_t cobs_decode(COBS_STATE *s, uint8_t *buf, uint8_t len);
+
+#ifdef BRIDGE_REPORTS
+extern BRIDGE_STATS bridge_stats;
+#endif
+
+#endif /* BRIDGE_H_ */
@@ -10,41 +10,113 @@
 #include "uart.h"
 #include "interrupts.h"
 #include "nrf24api.h"
+#include "survey.h"
+#include "bridge.h"
+#include "nrf_userconfig.h"
 #include "stdint.h"
-#include <stdio.h>
+#include "log.h"
+#include "prof.h"
+#include "trace.h"
 
-volatile uint16_t sys_event = 0;
+const SCHED_EVENT sched_events[SCHED_EVENTS] = {
+	{ spi_rx_event,		SCHED_DRAIN },
+	{ spi_tx_event,		0 },
+	{ uart_rx_event,	SCHED_DRAIN },
+	{ uart_tx_event,	SCHED_DRAIN },
+	{ ping_event,		0 },
+	{ rf_ready_event,	0 },
+	{ survey_event,		0 },
+#ifdef SPI_ASYNC
+	{ rf_written_event,	0 },
+#endif
+};
 
-// Receive event, triggered by IRQ receive event
+// Radio IRQ event: drains the RX FIFO straight to the UART, handles TX results
 void spi_rx_event() {
+	PROF_BEGIN(PROF_RECIEVE_BYTES);
 	recieve_bytes();
-	sys_event |= UART_TX_EVENT;
+	PROF_END(PROF_RECIEVE_BYTES);
 }
 
 // Transmit event
 void spi_tx_event() {
-	char i = 0;
+	uint8_t rec[LOG_HEADER + 2];  // One word; this is the deepest stack, see PKT_POOL_SIZE
 	static int tx_count = 0;
-	sprintf(buffer.buf, "\n\r%d: 123456789", ++tx_count);
-	while (buffer.buf[i]) {
-		i++;
-	}
-	buffer.size = i;
-	transmit_bytes();
+	uint16_t count = ++tx_count;
+
+	// A log record as payload: the PRX passes it to its UART, the host decodes it
+	transmit_bytes((const char *)rec, log_encode(rec, LOG_TX_COUNT, &count, 1));
 }
 
-// Serial UART receive, triggered by UART RX interrupt
+// Serial UART receive, triggered by UART RX interrupt: the PTX bridges it to the radio, the PRX echoes
 void uart_rx_event() {
+#if PTX_DEV
+	bridge_poll();
+#else
+	uint8_t data[8], n;
 
+	while ((n = uart_read(data, sizeof(data))))
+		print_x((const char *)data, n);
+#endif
 }
 
-// Serial UART transmit
+// Serial UART transmit: room in the TX buffer or new packets queued by the radio
 void uart_tx_event() {
-	print_x(buffer.buf, buffer.size);
+	PROF_BEGIN(PROF_UART_TX_EVENT);
+	radio_rx_drain();
+#ifdef PROFILE
+	prof_dump_poll();
+#endif
+#ifdef TRACE_ENABLE
+	trace_dump_poll();
+#endif
+	uart_tx_idle();
+	PROF_END(PROF_UART_TX_EVENT);
+}
+
+// Radio finished a timed init/power-up step
+void rf_ready_event() {
+	radio_ready();
+}
+
+#ifdef SPI_ASYNC
+// A queued packet has gone into the TX FIFO by interrupt-driven SPI
+void rf_written_event() {
+	radio_tx_written();
+}
+#endif
+
+// Spectrum survey: started by the button, then one sample per timer tick (TICK_HZ)
+void survey_event() {
+	if (survey_running)
+		survey_step();
+	else
+		survey_start();
 }
 
 // Ping connection
 void ping_event() {
+#if defined(BRIDGE_REPORTS) && PTX_DEV
+	static uint16_t reported = 0;
+#endif
+#ifdef POWER_REPORTS
+	static uint16_t powered = 0;
+#endif
+
+#if defined(BRIDGE_REPORTS) && PTX_DEV
+	if ((uint16_t)(tics - reported) >= BRIDGE_REPORT_SECS) {
+		reported = tics;
+		bridge_report();
+	}
+#endif
+#ifdef POWER_REPORTS
+	if ((uint16_t)(tics - powered) >= POWER_REPORT_SECS) {
+		powered = tics;
+		power_report();
+	}
+#endif
+	link_tick();
+	uart_tick();
 	if (is_connected()) {
 		connect_RF();
 	} else {
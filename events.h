@@ -6,19 +6,26 @@
  */
 
 #include "stdint.h"
+#include "sched.h"
+#include "nrf_userconfig.h"
 
 #ifndef EVENTS_H_
 #define EVENTS_H_
 
-//externs
-extern volatile uint16_t sys_event;
-
-// Event flags, in priority order
-#define SPI_TX_EVENT	BIT0
-#define SPI_RX_EVENT	BIT1
-#define UART_RX_EVENT	BIT2
-#define UART_TX_EVENT	BIT3
-#define PING_EVENT		BIT4
+// Events in priority order, each with its sched_events[] entry in events.c
+#define SPI_RX_EVENT	0	// also pending while rf_irq has RF24_IRQ_FLAGGED
+#define SPI_TX_EVENT	1
+#define UART_RX_EVENT	2
+#define UART_TX_EVENT	3
+#define PING_EVENT		4
+#define RF_READY_EVENT	5
+#define SURVEY_EVENT	6
+#ifdef SPI_ASYNC
+#define RF_WRITTEN_EVENT	7	// async payload write into the TX FIFO done
+#define SCHED_EVENTS	8
+#else
+#define SCHED_EVENTS	7
+#endif
 
 // prototypes
 void spi_rx_event();
@@ -26,6 +33,11 @@ void spi_tx_event();
 void uart_rx_event();
 void uart_tx_event();
 void ping_event();
+void rf_ready_event();
+void survey_event();
+#ifdef SPI_ASYNC
+void rf_written_event();
+#endif
 inline void connect_RF();
 inline void disconnect_RF();
 
@@ -9,91 +9,200 @@
 #include "interrupts.h"
 #include "events.h"
 #include "nrf24api.h"
+#include "nrf_userconfig.h"
+#include "timer.h"
+#include "log.h"
+#include "prof.h"
+#include "trace.h"
 #include "stdint.h"
 
-static volatile uint32_t WDT_Sec_Cnt = WDT_CPS;
-static volatile uint32_t toggle_led_cnt = 0;
-static uint32_t WDT_PWM_cnt = WDT_CPS / 16; // default 1/16 second interval. DO NOT DEFAULT TO ZERO.
-static const uint32_t WDT_PWM_max = WDT_CPS; // max 1 second interval
+#if defined(TICKLESS) && defined(SCHED_PROFILE)
+#error "TICKLESS and SCHED_PROFILE both want Timer0_A"
+#endif
 
-volatile uint16_t data_sender = DATA_DELAY;
-volatile uint16_t counter = TIMEOUT;
 volatile uint16_t tics = 0;
-volatile uint16_t delay_cnt = 0;
+volatile uint16_t clock_wakes = 0;	// timer interrupts, for POWER_REPORTS
+#ifndef TICKLESS
+static volatile uint16_t ticks = 0;	// WDT interrupts, free running
+#endif
+static volatile uint16_t clock_hi = 0;	// clock_now() above clock_ticks()
 
-uint32_t interrupts_set_WDT_interval(uint32_t interval) {
-	if (interval >= WDT_PWM_max)
-		WDT_PWM_cnt = 1; // reset to very low value (will toggle quickly)
-	else
-		WDT_PWM_cnt = interval;
-	return WDT_PWM_cnt;
-}
+static uint8_t second(TIMER *t);
+static uint8_t ping_due(TIMER *t);
+static TIMER second_timer = TIMER_CALL(second);
+static TIMER ping_timer = TIMER_CALL(ping_due);	// runs at half DELAY, see ping_due()
+static uint8_t ping_half = 0;
+#if PTX_DEV
+static TIMER sender_timer = TIMER_EVENT(SPI_TX_EVENT);
+#endif
 
-void interrupts_start_WDT_PWM() {
-	toggle_led_cnt = WDT_PWM_cnt;
+static uint8_t second(TIMER *t) {
+	tics++;
+	return 0;
 }
 
-void interrupts_stop_WDT_PWM() {
-	toggle_led_cnt = 0;
+// Connection drops half way through the ping interval unless a frame renews it
+static uint8_t ping_due(TIMER *t) {
+	if ((ping_half ^= 1))
+		sched_post_isr(PING_EVENT);
+	else
+		reset_connected();
+	return 0;
 }
 
-void interrupts_WDT_init() {
-	// configure Watchdog
-
+/* Time base for timer.c: the WDT interval interrupt, or with TICKLESS Timer0_A
+ * running continuously from ACLK, CCR1 set to the next deadline by timer.c and the
+ * overflow extending it to 32 bits.  The WDT stays held from main() then.
+ */
+void interrupts_clock_init() {
 	tics = 0;
+#ifdef TICKLESS
+	TA0CCTL1 = 0;
+	TA0CTL = TASSEL_1 | ID_0 | MC_2 | TACLR | TAIE;	// ACLK, continuous
+#else
+	// configure Watchdog
 	WDTCTL = WDT_CTL;					// Set Watchdog interval
-	WDT_Sec_Cnt = WDT_CPS;			// set WD 1 second counter
+	sched_hold(SCHED_SMCLK_TICK);		// WDT_CTL counts SMCLK
 	IE1 |= WDTIE;						// enable WDT interrupt
+#endif
+	timer_start(&second_timer, TICK_HZ, TICK_HZ);
+	timer_start(&ping_timer, 1, DELAY / 2);	// first ping right away
+#if PTX_DEV
+	timer_start(&sender_timer, DATA_DELAY, DATA_DELAY);
+#endif
 	_enable_interrupts(); // enable global interrupts
 	return;
 }
 
+// Timer ticks, free running
+uint16_t clock_ticks() {
+#ifdef TICKLESS
+	uint16_t t;
+
+	do {
+		t = TA0R;
+	} while (t != TA0R);  // ACLK is asynchronous to MCLK, take a stable read
+	return t;
+#else
+	return ticks;
+#endif
+}
+
+// Monotonic 32 bit timer ticks, also right with interrupts off and a wrap pending
+uint32_t clock_now() {
+	uint16_t state = __get_interrupt_state(), hi, lo;
+
+	__disable_interrupt();
+	hi = clock_hi;
+	lo = clock_ticks();
+#ifdef TICKLESS
+	if ((TA0CTL & TAIFG) && lo < 0x8000)
+		hi++;
+#else
+	if ((IFG1 & WDTIFG) && lo == 0xFFFF) {
+		hi++;
+		lo = 0;
+	}
+#endif
+	__set_interrupt_state(state);
+	return (uint32_t)hi << 16 | lo;
+}
+
+#ifdef POWER_REPORTS
+/* Wakeups per second over the last report period, and a current estimate from the
+ * time the main loop was awake plus POWER_WAKE_US per timer interrupt.
+ */
+void power_report() {
+	static uint32_t since = 0, asleep = 0;
+	static uint16_t wakes = 0, sleeps = 0;
+	uint32_t now = clock_now(), span = now - since;
+	uint16_t secs = span / TICK_HZ, per_mille, floor_ua;
+	uint32_t active_us;
+
+	if (!secs)
+		return;
+	active_us = (span - (sched_asleep - asleep)) * (1000000UL / TICK_HZ)
+			+ (uint32_t)(uint16_t)(clock_wakes - wakes) * POWER_WAKE_US;
+	per_mille = active_us / (secs * 1000UL);
+	if (per_mille > 1000)
+		per_mille = 1000;
+	floor_ua = sched_keep ? POWER_LPM1_UA : POWER_LPM3_UA;
+	LOG(LOG_POWER, (uint16_t)(clock_wakes - wakes) / secs, (uint16_t)(sched_sleeps - sleeps) / secs,
+			per_mille, floor_ua + (uint16_t)((uint32_t)per_mille * (POWER_ACTIVE_UA - floor_ua) / 1000));
+	since = now;
+	asleep = sched_asleep;
+	wakes = clock_wakes;
+	sleeps = sched_sleeps;
+}
+#endif
+
 //----------------------------------------------------------------------
+static uint8_t delay_done(TIMER *t) {
+	return 1;
+}
+
+// Sleep for time timer ticks; other events are left pending meanwhile
 void delay(uint16_t time) {
-	delay_cnt = time;
-	LPM3;
+	TIMER t = TIMER_CALL(delay_done);
+
+	timer_start(&t, time, 0);
+	_disable_interrupts();
+	while (timer_armed(&t)) {
+		sched_sleep();
+		_disable_interrupts();
+	}
+	_enable_interrupts();
 }
 
 //---------------------------------------------------------------------
+// Restart the ping interval from now
 void set_timeout() {
-	counter = DELAY;
+	ping_half = 1;
+	timer_start(&ping_timer, DELAY / 2, DELAY / 2);
 }
 
+// Stop pinging
 void reset_timeout() {
-	counter = 0;
+	timer_stop(&ping_timer);
 }
 
+#ifdef TICKLESS
+//-- Timer0_A CCR1/overflow ISR: a deadline, or the clock wrapped ----------
+//
+#pragma vector = TIMER0_A1_VECTOR
+__interrupt void TA0_ISR(void) {
+	if (TA0IV == TA0IV_TAIFG)
+		clock_hi++;
+	clock_wakes++;
+	if (timer_tick(clock_ticks()) || sys_event)
+		__bic_SR_register_on_exit(LPM4_bits);
+}
+#else
 //-- Watchdog Timer ISR ---------------------------------------------
 //
 #pragma vector = WDT_VECTOR
 __interrupt void WDT_ISR(void) {
-	// one second event --------------------------------
-	if (--WDT_Sec_Cnt == 0) {
-		WDT_Sec_Cnt = WDT_CPS;
-		tics++;
-	}
-
-//	if (counter) {
-	if (--counter == DELAY / 2)
-		reset_connected();
-	else if (counter == 0) {
-		counter = DELAY;
-		sys_event |= PING_EVENT;
-	}
-//	}
-
-#if PTX_DEV
-	if (--data_sender == 0) {
-		data_sender = DATA_DELAY;
-		sys_event |= SPI_TX_EVENT;
-	}
+	PROF_BEGIN(PROF_WDT_ISR);
+	if (!++ticks)
+		clock_hi++;
+	clock_wakes++;
+	// Timed work is on timer.c's wheel, one slot looked at per tick
+	if (timer_tick(ticks) || sys_event)
+		__bic_SR_register_on_exit(LPM4_bits);
+	PROF_END(PROF_WDT_ISR);
+}
 #endif
 
-	if (delay_cnt && !(--delay_cnt)) {
-		__bic_SR_register_on_exit(LPM3_bits);
-	}
-
-	if (sys_event)
+//-- Port 1 ISR: button starts a spectrum survey ----------------------
+//
+#if nrfIRQport != 1
+#pragma vector = PORT1_VECTOR
+__interrupt void P1_ISR(void) {
+	if (P1IFG & SWTCH0) {
+		P1IFG &= ~SWTCH0;
+		TRACE_ISR(TRACE_BUTTON, 0);
+		sched_post_isr(SURVEY_EVENT);
 		__bic_SR_register_on_exit(LPM4_bits);
+	}
 }
-
+#endif
@@ -9,6 +9,7 @@
 #define INTERRUPTS_H_
 
 #include <stdint.h>
+#include "nrf_userconfig.h"
 
 #define myCLOCK	16000000			// clock speed 1.2 Mhz
 #define WDT_CLOCK 8000000
@@ -17,8 +18,24 @@
 #define	WDT_CPS	(WDT_CLOCK/WDT_INT)	// WD clocks / second count = WDT interrupts / second (500 @16MHz clk)
 #define HALF_SECOND (WDT_CPS / 2)
 
-#define DELAY WDT_CPS/2
-#define DATA_DELAY WDT_CPS/40
+// Timer (timer.h) ticks per second
+#ifdef TICKLESS
+#define TICK_HZ	ACLK_HZ				// Timer0_A counts ACLK
+#else
+#define TICK_HZ	WDT_CPS
+#endif
+
+#define DELAY TICK_HZ/2
+#define DATA_DELAY TICK_HZ/40
+
+/* POWER_REPORTS current model, MSP430G2553 typical at 3V, radio not included.  A
+ * wakeup that doesn't reach the main loop (a timer tick) is charged POWER_WAKE_US.
+ */
+#define POWER_ACTIVE_UA	4200		// 16MHz active
+#define POWER_LPM1_UA	600			// DCO kept running for SMCLK
+#define POWER_LPM3_UA	1			// VLO only
+#define POWER_WAKE_US	4
+#define POWER_REPORT_SECS	10
 
 #define GLED BIT4
 #define RLED BIT0
@@ -26,15 +43,18 @@
 
 extern volatile uint16_t timeout;
 extern volatile uint16_t tics;
+extern volatile uint16_t clock_wakes;
 
-void interrupts_WDT_init();
-uint32_t interrupts_set_WDT_interval(uint32_t interval);
-void interrupts_start_WDT_PWM();
-void interrupts_stop_WDT_PWM();
+void interrupts_clock_init();
+uint16_t clock_ticks();
+uint32_t clock_now();
+void power_report();
 void delay(uint16_t time);
 void set_timeout();
 void reset_timeout();
 
 #define PTX_DEV 1
+#define HUB_DEV 0	// PRX only: serve six sensor nodes on pipes 0-5
+#define HUB_NODE 0	// PTX only: hub pipe to send to, 0 = point to point link
 
 #endif /* INTERRUPTS_H_ */
@@ -0,0 +1,32 @@
+/*
+ * log.c
+ *
+ * Binary log records into the UART TX ring, see log.h.
+ */
+
+#include <msp430.h>
+#include <string.h>
+#include "log.h"
+#include "uart.h"
+
+uint16_t log_dropped;	// records that didn't fit in the TX ring
+
+// Build a record in buf (LOG_RECORD_MAX bytes), returns its length
+uint8_t log_encode(uint8_t *buf, uint8_t id, const uint16_t *args, uint8_t words) {
+	buf[0] = LOG_SYNC;
+	buf[1] = id;
+	buf[2] = words;
+	memcpy(buf + LOG_HEADER, args, words << 1);  // MSP430 is little endian already
+	return LOG_HEADER + (words << 1);
+}
+
+void log_emit(uint8_t id, const uint16_t *args, uint8_t words) {
+	uint8_t rec[LOG_RECORD_MAX];
+	uint8_t len = log_encode(rec, id, args, words);
+
+	if (uart_tx_room() < len) {
+		log_dropped++;
+		return;
+	}
+	print_x((const char *)rec, len);
+}
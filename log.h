@@ -0,0 +1,41 @@
+/*
+ * log.h
+ *
+ * Tokenized logging: instead of formatting text, LOG() queues a format id from
+ * log_ids.h and its arguments as raw 16 bit words, and tools/logdecode.py turns that
+ * back into text on the host.  A record is
+ *
+ *   { LOG_SYNC, id, word count, words (little endian)... }
+ *
+ * and is queued whole or not at all, so a busy UART costs a record (log_dropped),
+ * never a garbled one.  Everything else on the line (print() text, radio data) passes
+ * through the decoder untouched.  LOG_SYNC is the ASCII record separator, which text
+ * never has; in binary data it only decodes if an id and matching count follow.
+ */
+
+#ifndef LOG_H_
+#define LOG_H_
+
+#include <stdint.h>
+#include "log_ids.h"
+
+#define LOG_SYNC		0x1E
+#define LOG_MAX_WORDS	8
+#define LOG_HEADER		3
+#define LOG_RECORD_MAX	(LOG_HEADER + 2 * LOG_MAX_WORDS)
+
+// A 32 bit argument takes two words, low first; x is evaluated twice
+#define LOG_U32(x)		(uint16_t)(x), (uint16_t)((uint32_t)(x) >> 16)
+
+#define LOG0(id)		log_emit(id, 0, 0)
+#define LOG(id, ...)	do { \
+		const uint16_t log_args[] = { __VA_ARGS__ }; \
+		log_emit(id, log_args, sizeof(log_args) / sizeof(log_args[0])); \
+	} while (0)
+
+void log_emit(uint8_t id, const uint16_t *args, uint8_t words);
+uint8_t log_encode(uint8_t *buf, uint8_t id, const uint16_t *args, uint8_t words);
+
+extern uint16_t log_dropped;
+
+#endif /* LOG_H_ */
@@ -0,0 +1,36 @@
+/*
+ * log_ids.h
+ *
+ * Every LOG() format string, one X(id, format) line each.  The firmware only ever
+ * sees the ids; tools/logdecode.py reads the strings from this file, so it is the
+ * one table both sides are built from.  Append new formats at the end, ids are
+ * positions and old captures decode against the table they were made with.
+ *
+ * Formats take %u, %d, %x (16 bit) and %lu, %ld, %lx (32 bit, LOG_U32()) only.
+ */
+
+#ifndef LOG_IDS_H_
+#define LOG_IDS_H_
+
+#define LOG_FORMATS \
+	X(LOG_TX_COUNT,		"\n\r%d: 123456789") \
+	X(LOG_RATE,			"\n\rrate %u: %lu B/s") \
+	X(LOG_QUIET,		"\n\rquiet: %u %u %u\n\r") \
+	X(LOG_BRIDGE,		"\n\rbridge: %lu B in %u pkts, wait avg %u max %u") \
+	X(LOG_BULK,			"\n\rbulk: %u B %lu us %u resent") \
+	X(LOG_TX_BENCH,		"\n\rtx bench: %lu us %u / %lu us %u") \
+	X(LOG_NOACK,		"\n\rnoack: %lu us") \
+	X(LOG_SPI_BENCH,	"\n\r%u: %u %u / %u %u") \
+	X(LOG_POWER,		"\n\rpower: %u wakes/s, %u loop/s, %u/1000 awake, ~%u uA") \
+	X(LOG_PROF_HEAD,	"\n\rprofile: %u probes, %u cycles/tick, overhead %u") \
+	X(LOG_PROF,			"\n\rprobe %u: %lu calls, min %u max %u total %lu") \
+	X(LOG_TRACE_HEAD,	"\n\rtrace: %u entries, %u written, %u ticks/s, boot %u") \
+	X(LOG_TRACE,		"\n\r%u: %x") \
+	X(LOG_REG_BENCH,	"\n\rreg %u: %u -> %u SPI bytes") \
+	X(LOG_REG_SHADOW,	"\n\rshadow: %u registers differ")
+
+#define X(id, format)	id,
+typedef enum { LOG_FORMATS LOG_IDS } LOG_ID;
+#undef X
+
+#endif /* LOG_IDS_H_ */
@@ -23,68 +23,43 @@
 #include "uart.h"
 #include "nrf24api.h"
 #include "events.h"
+#include "prof.h"
+#include "trace.h"
 
 void port1_init();
 
 void main() {
 
 	WDTCTL = WDTHOLD | WDTPW;
+#ifdef TRACE_ENABLE
+	trace_init();  // Before anything clears the reset flags
+#endif
 	DCOCTL = CALDCO_16MHZ;
 	BCSCTL1 = CALBC1_16MHZ;
 	BCSCTL2 = DIVS_1;  // SMCLK = DCOCLK/2
+	BCSCTL3 |= LFXT1S_2;  // ACLK = VLO, times the radio's power-up waits in LPM3
 	// SPI (USCI) uses SMCLK, prefer SMCLK < 10MHz (SPI speed limit for nRF24 = 10MHz)
 
+#ifdef PROFILE
+	prof_init();
+#endif
 	port1_init();
-	interrupts_WDT_init();
+	interrupts_clock_init();
 	uart_init();
-	radio_init();
+	radio_init();  // SPI_BENCHMARK runs once it is done, see radio_ready()
 
 #if PTX_DEV
-	open_stream(TX_MODE);
+#if HUB_NODE
+	radio_set_node(HUB_NODE);
+#endif
+	open_stream(TX_STREAM_MODE);
+#elif HUB_DEV
+	open_stream(RX_HUB_MODE);
 #else
 	open_stream(RX_MODE);
 #endif
 
-	while (1) {
-		// disable interrupts while checking sys_event
-		_disable_interrupts();
-
-		// if event pending, enable interrupts
-		if (sys_event || rf_irq)
-			_enable_interrupt();
-
-		// else enable interrupts and goto sleep
-		else {
-			__bis_SR_register(LPM1_bits | GIE);
-		}
-
-		if (rf_irq & RF24_IRQ_FLAGGED) {
-			spi_rx_event();
-		} else {
-
-			if (sys_event & SPI_TX_EVENT) {
-				sys_event &= ~SPI_TX_EVENT;
-				spi_tx_event();
-			} else if (sys_event & UART_RX_EVENT) {
-				sys_event &= ~UART_RX_EVENT;
-				uart_rx_event();
-			} else if (sys_event & UART_TX_EVENT) {
-				sys_event &= ~UART_TX_EVENT;
-				uart_tx_event();
-			} else if (sys_event & PING_EVENT) {
-				sys_event &= ~PING_EVENT;
-				ping_event();
-			} else {
-				P1OUT &= ~(RLED + GLED);
-				while (1) {
-					delay(50);
-					P1OUT ^= RLED + GLED;
-				}
-
-			}
-		}
-
-	}
+	sched_run();
 }
 
 void port1_init(void) {
@@ -98,7 +73,7 @@ void port1_init(void) {
 	P1OUT |= (SWTCH0);					// use pull-ups
 	P1IES |= (SWTCH0);					// high to low transition
 	P1REN |= (SWTCH0);					// Enable pull-ups
-//	P1IE |= (SWTCH0);						// P1.0-3 interrupt enabled
-//	P1IFG &= ~(SWTCH0);						// P1.0-3 IFG cleared
+	P1IE |= (SWTCH0);						// P1.3 interrupt enabled, starts a spectrum survey
+	P1IFG &= ~(SWTCH0);						// P1.3 IFG cleared
 	return;
 } // end port1_init
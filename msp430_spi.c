@@ -57,6 +57,41 @@ uint16_t spi_transfer16(uint16_t inw)
 	return USISR;
 }
 
+/* USI has a single shift register and no TX buffer, so block transfers are
+ * straight byte loops without the function call overhead of spi_transfer().
+ */
+void spi_transfer_block(const uint8_t *tx, uint8_t *rx, uint8_t len)
+{
+	while (len--) {
+		USISRL = *tx++;
+		USICNT = 8;
+		while ( !(USICTL1 & USIIFG) )
+			;
+		*rx++ = USISRL;
+	}
+}
+
+void spi_write_block(const uint8_t *tx, uint8_t len)
+{
+	while (len--) {
+		USISRL = *tx++;
+		USICNT = 8;
+		while ( !(USICTL1 & USIIFG) )
+			;
+	}
+}
+
+void spi_read_block(uint8_t *rx, uint8_t len)
+{
+	while (len--) {
+		USISRL = 0xFF;
+		USICNT = 8;
+		while ( !(USICTL1 & USIIFG) )
+			;
+		*rx++ = USISRL;
+	}
+}
+
 /* Not used by msprf24, but added for courtesy (LCD display support).  9-bit SPI. */
 uint16_t spi_transfer9(uint16_t inw)
 {
@@ -114,6 +149,70 @@ uint16_t spi_transfer16(uint16_t inw)
 	return retw;
 }
 
+/* Block transfers keep the double-buffered TXBUF loaded so consecutive bytes are
+ * clocked out back-to-back.  Interrupts are held off while RX data is collected
+ * since a late read of RXBUF would be overrun by the following byte.
+ */
+void spi_transfer_block(const uint8_t *tx, uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCA0TXBUF = *tx++;
+	while (--len) {
+		while ( !(IFG2 & UCA0TXIFG) )  // TXBUF frees up as soon as the previous byte starts shifting
+			;
+		UCA0TXBUF = *tx++;
+		while ( !(IFG2 & UCA0RXIFG) )
+			;
+		*rx++ = UCA0RXBUF;
+	}
+	while ( !(IFG2 & UCA0RXIFG) )
+		;
+	*rx = UCA0RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
+void spi_write_block(const uint8_t *tx, uint8_t len)
+{
+	while (len--) {
+		while ( !(IFG2 & UCA0TXIFG) )
+			;
+		UCA0TXBUF = *tx++;
+	}
+	while ( UCA0STAT & UCBUSY )  // Wait for the last byte to leave the shift register
+		;
+	(void)UCA0RXBUF;  // Discard SOMI data, clears RXIFG and the overrun flag
+}
+
+void spi_read_block(uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCA0TXBUF = 0xFF;
+	while (--len) {
+		while ( !(IFG2 & UCA0TXIFG) )
+			;
+		UCA0TXBUF = 0xFF;
+		while ( !(IFG2 & UCA0RXIFG) )
+			;
+		*rx++ = UCA0RXBUF;
+	}
+	while ( !(IFG2 & UCA0RXIFG) )
+		;
+	*rx = UCA0RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
 uint16_t spi_transfer9(uint16_t inw)
 {
 	uint8_t p1dir_save, p1out_save, p1ren_save;
@@ -165,6 +264,7 @@ void spi_init()
 
 uint8_t spi_transfer(uint8_t inb)
 {
+	SPI_COUNT(1);
 	UCB0TXBUF = inb;
 	while ( !(IFG2 & UCB0RXIFG) )  // Wait for RXIFG indicating remote byte received via SOMI
 		;
@@ -176,6 +276,7 @@ uint16_t spi_transfer16(uint16_t inw)
 	uint16_t retw;
 	uint8_t *retw8 = (uint8_t *)&retw, *inw8 = (uint8_t *)&inw;
 
+	SPI_COUNT(2);
 	UCB0TXBUF = inw8[1];
 	while ( !(IFG2 & UCB0RXIFG) )
 		;
@@ -187,6 +288,69 @@ uint16_t spi_transfer16(uint16_t inw)
 	return retw;
 }
 
+void spi_transfer_block(const uint8_t *tx, uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	SPI_COUNT(len);
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCB0TXBUF = *tx++;
+	while (--len) {
+		while ( !(IFG2 & UCB0TXIFG) )  // TXBUF frees up as soon as the previous byte starts shifting
+			;
+		UCB0TXBUF = *tx++;
+		while ( !(IFG2 & UCB0RXIFG) )
+			;
+		*rx++ = UCB0RXBUF;
+	}
+	while ( !(IFG2 & UCB0RXIFG) )
+		;
+	*rx = UCB0RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
+void spi_write_block(const uint8_t *tx, uint8_t len)
+{
+	SPI_COUNT(len);
+	while (len--) {
+		while ( !(IFG2 & UCB0TXIFG) )
+			;
+		UCB0TXBUF = *tx++;
+	}
+	while ( UCB0STAT & UCBUSY )  // Wait for the last byte to leave the shift register
+		;
+	(void)UCB0RXBUF;  // Discard SOMI data, clears RXIFG and the overrun flag
+}
+
+void spi_read_block(uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	SPI_COUNT(len);
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCB0TXBUF = 0xFF;
+	while (--len) {
+		while ( !(IFG2 & UCB0TXIFG) )
+			;
+		UCB0TXBUF = 0xFF;
+		while ( !(IFG2 & UCB0RXIFG) )
+			;
+		*rx++ = UCB0RXBUF;
+	}
+	while ( !(IFG2 & UCB0RXIFG) )
+		;
+	*rx = UCB0RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
 uint16_t spi_transfer9(uint16_t inw)
 {
 	uint8_t p1dir_save, p1out_save, p1ren_save;
@@ -218,6 +382,99 @@ uint16_t spi_transfer9(uint16_t inw)
 	retw |= spi_transfer( (uint8_t)(inw & 0x00FF) );
 	return retw;
 }
+
+#ifdef REG_BENCHMARK
+uint16_t spi_bytes = 0;
+#endif
+
+#ifdef SPI_ASYNC
+/* Interrupt-driven transactions.  One byte is in flight at a time; each RXIFG
+ * stores the byte just received and loads the next one, so the CPU can sleep
+ * between bytes.  Descriptors are owned by the caller and chained in
+ * submission order.
+ */
+SPI_XFER * volatile spi_xfer_head;
+static uint8_t spi_xfer_pos;
+
+static void spi_async_start(SPI_XFER *xfer)
+{
+	spi_xfer_pos = 0;
+	nrfCSNportout &= ~nrfCSNpin;
+	(void)UCB0RXBUF;  // Make sure a stale RXIFG doesn't fire the first interrupt
+	IE2 |= UCB0RXIE;
+	UCB0TXBUF = xfer->cmd;
+}
+
+void spi_async_submit(SPI_XFER *xfer)
+{
+	SPI_XFER *x;
+	uint16_t sr;
+
+	xfer->next = 0;
+	xfer->busy = 1;
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	if (spi_xfer_head) {
+		for (x = spi_xfer_head; x->next; x = x->next)
+			;
+		x->next = xfer;
+	} else {
+		spi_xfer_head = xfer;
+		spi_async_start(xfer);
+	}
+	if (sr)
+		_enable_interrupts();
+}
+
+/* Called from the USCIAB0RX vector when UCB0RXIFG is pending.  Returns 1 when a
+ * transaction completed so the ISR can wake the main loop.
+ */
+uint8_t spi_async_isr()
+{
+	SPI_XFER *xfer = spi_xfer_head;
+	uint8_t c = UCB0RXBUF;
+
+	SPI_COUNT(1);
+	if (spi_xfer_pos == 0)
+		xfer->status = c;
+	else if (xfer->rx)
+		xfer->rx[spi_xfer_pos - 1] = c;
+
+	if (spi_xfer_pos < xfer->len) {
+		UCB0TXBUF = xfer->tx ? xfer->tx[spi_xfer_pos] : 0xFF;
+		spi_xfer_pos++;
+		return 0;
+	}
+
+	nrfCSNportout |= nrfCSNpin;
+	spi_xfer_head = xfer->next;
+	xfer->busy = 0;
+	if (xfer->done)
+		xfer->done(xfer);
+	if (spi_xfer_head)
+		spi_async_start(spi_xfer_head);
+	else
+		IE2 &= ~UCB0RXIE;
+	return 1;
+}
+
+/* Runs the queue to the end with interrupts off, so the ISR can't race us; done() is
+ * called from here then.  Works from inside the USCIAB0RX ISR as well.
+ */
+void spi_async_drain()
+{
+	uint16_t sr = __get_SR_register() & GIE;
+
+	_disable_interrupts();
+	while (spi_xfer_head) {
+		while (!(IFG2 & UCB0RXIFG))
+			;
+		spi_async_isr();
+	}
+	if (sr)
+		_enable_interrupts();
+}
+#endif
 #endif
 // USCI for G2xx4/G2xx5 devices
 #if defined(__MSP430_HAS_USCI__) && defined(SPI_DRIVER_USCI_A) && defined(__MSP430_HAS_TB3__)
@@ -260,6 +517,66 @@ uint16_t spi_transfer16(uint16_t inw)
 	return retw;
 }
 
+void spi_transfer_block(const uint8_t *tx, uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCA0TXBUF = *tx++;
+	while (--len) {
+		while ( !(IFG2 & UCA0TXIFG) )  // TXBUF frees up as soon as the previous byte starts shifting
+			;
+		UCA0TXBUF = *tx++;
+		while ( !(IFG2 & UCA0RXIFG) )
+			;
+		*rx++ = UCA0RXBUF;
+	}
+	while ( !(IFG2 & UCA0RXIFG) )
+		;
+	*rx = UCA0RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
+void spi_write_block(const uint8_t *tx, uint8_t len)
+{
+	while (len--) {
+		while ( !(IFG2 & UCA0TXIFG) )
+			;
+		UCA0TXBUF = *tx++;
+	}
+	while ( UCA0STAT & UCBUSY )  // Wait for the last byte to leave the shift register
+		;
+	(void)UCA0RXBUF;  // Discard SOMI data, clears RXIFG and the overrun flag
+}
+
+void spi_read_block(uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCA0TXBUF = 0xFF;
+	while (--len) {
+		while ( !(IFG2 & UCA0TXIFG) )
+			;
+		UCA0TXBUF = 0xFF;
+		while ( !(IFG2 & UCA0RXIFG) )
+			;
+		*rx++ = UCA0RXBUF;
+	}
+	while ( !(IFG2 & UCA0RXIFG) )
+		;
+	*rx = UCA0RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
 uint16_t spi_transfer9(uint16_t inw)
 {
 	uint8_t p3dir_save, p3out_save, p3ren_save;
@@ -331,6 +648,66 @@ uint16_t spi_transfer16(uint16_t inw)
 	return retw;
 }
 
+void spi_transfer_block(const uint8_t *tx, uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCB0TXBUF = *tx++;
+	while (--len) {
+		while ( !(IFG2 & UCB0TXIFG) )  // TXBUF frees up as soon as the previous byte starts shifting
+			;
+		UCB0TXBUF = *tx++;
+		while ( !(IFG2 & UCB0RXIFG) )
+			;
+		*rx++ = UCB0RXBUF;
+	}
+	while ( !(IFG2 & UCB0RXIFG) )
+		;
+	*rx = UCB0RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
+void spi_write_block(const uint8_t *tx, uint8_t len)
+{
+	while (len--) {
+		while ( !(IFG2 & UCB0TXIFG) )
+			;
+		UCB0TXBUF = *tx++;
+	}
+	while ( UCB0STAT & UCBUSY )  // Wait for the last byte to leave the shift register
+		;
+	(void)UCB0RXBUF;  // Discard SOMI data, clears RXIFG and the overrun flag
+}
+
+void spi_read_block(uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCB0TXBUF = 0xFF;
+	while (--len) {
+		while ( !(IFG2 & UCB0TXIFG) )
+			;
+		UCB0TXBUF = 0xFF;
+		while ( !(IFG2 & UCB0RXIFG) )
+			;
+		*rx++ = UCB0RXBUF;
+	}
+	while ( !(IFG2 & UCB0RXIFG) )
+		;
+	*rx = UCB0RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
 uint16_t spi_transfer9(uint16_t inw)
 {
 	uint8_t p3dir_save, p3out_save, p3ren_save;
@@ -409,6 +786,66 @@ uint16_t spi_transfer16(uint16_t inw)
 	return retw;
 }
 
+void spi_transfer_block(const uint8_t *tx, uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCA0TXBUF = *tx++;
+	while (--len) {
+		while ( !(UCA0IFG & UCTXIFG) )  // TXBUF frees up as soon as the previous byte starts shifting
+			;
+		UCA0TXBUF = *tx++;
+		while ( !(UCA0IFG & UCRXIFG) )
+			;
+		*rx++ = UCA0RXBUF;
+	}
+	while ( !(UCA0IFG & UCRXIFG) )
+		;
+	*rx = UCA0RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
+void spi_write_block(const uint8_t *tx, uint8_t len)
+{
+	while (len--) {
+		while ( !(UCA0IFG & UCTXIFG) )
+			;
+		UCA0TXBUF = *tx++;
+	}
+	while ( UCA0STAT & UCBUSY )  // Wait for the last byte to leave the shift register
+		;
+	(void)UCA0RXBUF;  // Discard SOMI data, clears RXIFG and the overrun flag
+}
+
+void spi_read_block(uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCA0TXBUF = 0xFF;
+	while (--len) {
+		while ( !(UCA0IFG & UCTXIFG) )
+			;
+		UCA0TXBUF = 0xFF;
+		while ( !(UCA0IFG & UCRXIFG) )
+			;
+		*rx++ = UCA0RXBUF;
+	}
+	while ( !(UCA0IFG & UCRXIFG) )
+		;
+	*rx = UCA0RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
 #ifdef __MS430F5172
 uint16_t spi_transfer9(uint16_t inw)
 {
@@ -520,6 +957,66 @@ uint16_t spi_transfer16(uint16_t inw)
 	return retw;
 }
 
+void spi_transfer_block(const uint8_t *tx, uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCB0TXBUF = *tx++;
+	while (--len) {
+		while ( !(UCB0IFG & UCTXIFG) )  // TXBUF frees up as soon as the previous byte starts shifting
+			;
+		UCB0TXBUF = *tx++;
+		while ( !(UCB0IFG & UCRXIFG) )
+			;
+		*rx++ = UCB0RXBUF;
+	}
+	while ( !(UCB0IFG & UCRXIFG) )
+		;
+	*rx = UCB0RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
+void spi_write_block(const uint8_t *tx, uint8_t len)
+{
+	while (len--) {
+		while ( !(UCB0IFG & UCTXIFG) )
+			;
+		UCB0TXBUF = *tx++;
+	}
+	while ( UCB0STAT & UCBUSY )  // Wait for the last byte to leave the shift register
+		;
+	(void)UCB0RXBUF;  // Discard SOMI data, clears RXIFG and the overrun flag
+}
+
+void spi_read_block(uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCB0TXBUF = 0xFF;
+	while (--len) {
+		while ( !(UCB0IFG & UCTXIFG) )
+			;
+		UCB0TXBUF = 0xFF;
+		while ( !(UCB0IFG & UCRXIFG) )
+			;
+		*rx++ = UCB0RXBUF;
+	}
+	while ( !(UCB0IFG & UCRXIFG) )
+		;
+	*rx = UCB0RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
 #ifdef __MSP430F5172
 uint16_t spi_transfer9(uint16_t inw)
 {
@@ -632,6 +1129,66 @@ uint16_t spi_transfer16(uint16_t inw)
 	return retw;
 }
 
+void spi_transfer_block(const uint8_t *tx, uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCA0TXBUF = *tx++;
+	while (--len) {
+		while ( !(UCA0IFG & UCTXIFG) )  // TXBUF frees up as soon as the previous byte starts shifting
+			;
+		UCA0TXBUF = *tx++;
+		while ( !(UCA0IFG & UCRXIFG) )
+			;
+		*rx++ = UCA0RXBUF;
+	}
+	while ( !(UCA0IFG & UCRXIFG) )
+		;
+	*rx = UCA0RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
+void spi_write_block(const uint8_t *tx, uint8_t len)
+{
+	while (len--) {
+		while ( !(UCA0IFG & UCTXIFG) )
+			;
+		UCA0TXBUF = *tx++;
+	}
+	while ( UCA0STATW & UCBUSY )  // Wait for the last byte to leave the shift register
+		;
+	(void)UCA0RXBUF;  // Discard SOMI data, clears RXIFG and the overrun flag
+}
+
+void spi_read_block(uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCA0TXBUF = 0xFF;
+	while (--len) {
+		while ( !(UCA0IFG & UCTXIFG) )
+			;
+		UCA0TXBUF = 0xFF;
+		while ( !(UCA0IFG & UCRXIFG) )
+			;
+		*rx++ = UCA0RXBUF;
+	}
+	while ( !(UCA0IFG & UCRXIFG) )
+		;
+	*rx = UCA0RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
 #ifdef __MSP430FR5969__
 uint16_t spi_transfer9(uint16_t inw)
 {
@@ -722,6 +1279,66 @@ uint16_t spi_transfer16(uint16_t inw)
 	return retw;
 }
 
+void spi_transfer_block(const uint8_t *tx, uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCA1TXBUF = *tx++;
+	while (--len) {
+		while ( !(UCA1IFG & UCTXIFG) )  // TXBUF frees up as soon as the previous byte starts shifting
+			;
+		UCA1TXBUF = *tx++;
+		while ( !(UCA1IFG & UCRXIFG) )
+			;
+		*rx++ = UCA1RXBUF;
+	}
+	while ( !(UCA1IFG & UCRXIFG) )
+		;
+	*rx = UCA1RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
+void spi_write_block(const uint8_t *tx, uint8_t len)
+{
+	while (len--) {
+		while ( !(UCA1IFG & UCTXIFG) )
+			;
+		UCA1TXBUF = *tx++;
+	}
+	while ( UCA1STATW & UCBUSY )  // Wait for the last byte to leave the shift register
+		;
+	(void)UCA1RXBUF;  // Discard SOMI data, clears RXIFG and the overrun flag
+}
+
+void spi_read_block(uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCA1TXBUF = 0xFF;
+	while (--len) {
+		while ( !(UCA1IFG & UCTXIFG) )
+			;
+		UCA1TXBUF = 0xFF;
+		while ( !(UCA1IFG & UCRXIFG) )
+			;
+		*rx++ = UCA1RXBUF;
+	}
+	while ( !(UCA1IFG & UCRXIFG) )
+		;
+	*rx = UCA1RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
 #ifdef __MSP430FR5969__
 uint16_t spi_transfer9(uint16_t inw)
 {
@@ -803,6 +1420,66 @@ uint16_t spi_transfer16(uint16_t inw)
 	return retw;
 }
 
+void spi_transfer_block(const uint8_t *tx, uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCB0TXBUF = *tx++;
+	while (--len) {
+		while ( !(UCB0IFG & UCTXIFG) )  // TXBUF frees up as soon as the previous byte starts shifting
+			;
+		UCB0TXBUF = *tx++;
+		while ( !(UCB0IFG & UCRXIFG) )
+			;
+		*rx++ = UCB0RXBUF;
+	}
+	while ( !(UCB0IFG & UCRXIFG) )
+		;
+	*rx = UCB0RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
+void spi_write_block(const uint8_t *tx, uint8_t len)
+{
+	while (len--) {
+		while ( !(UCB0IFG & UCTXIFG) )
+			;
+		UCB0TXBUF = *tx++;
+	}
+	while ( UCB0STATW & UCBUSY )  // Wait for the last byte to leave the shift register
+		;
+	(void)UCB0RXBUF;  // Discard SOMI data, clears RXIFG and the overrun flag
+}
+
+void spi_read_block(uint8_t *rx, uint8_t len)
+{
+	uint16_t sr;
+
+	if (!len)
+		return;
+	sr = __get_SR_register() & GIE;
+	_disable_interrupts();
+	UCB0TXBUF = 0xFF;
+	while (--len) {
+		while ( !(UCB0IFG & UCTXIFG) )
+			;
+		UCB0TXBUF = 0xFF;
+		while ( !(UCB0IFG & UCRXIFG) )
+			;
+		*rx++ = UCB0RXBUF;
+	}
+	while ( !(UCB0IFG & UCRXIFG) )
+		;
+	*rx = UCB0RXBUF;
+	if (sr)
+		_enable_interrupts();
+}
+
 #ifdef __MSP430FR5969__
 uint16_t spi_transfer9(uint16_t inw)
 {
@@ -849,3 +1526,10 @@ uint16_t spi_transfer9(uint16_t inw)
 #endif
 
 #endif
+
+#if defined(SPI_ASYNC) && !(defined(__MSP430_HAS_USCI__) && defined(SPI_DRIVER_USCI_B) && !defined(__MSP430_HAS_TB3__))
+#error "SPI_ASYNC is only implemented for USCI_B on F2xxx/G2xx3 devices"
+#endif
+#if defined(REG_BENCHMARK) && !(defined(__MSP430_HAS_USCI__) && defined(SPI_DRIVER_USCI_B) && !defined(__MSP430_HAS_TB3__))
+#error "REG_BENCHMARK only counts bytes in the USCI_B driver for F2xxx/G2xx3 devices"
+#endif
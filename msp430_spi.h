@@ -19,10 +19,47 @@
 #define _MSP430_SPI_H_
 
 #include <stdint.h>
+#include "nrf_userconfig.h"
 
 void spi_init();
 uint8_t spi_transfer(uint8_t);  // SPI xfer 1 byte
 uint16_t spi_transfer16(uint16_t);  // SPI xfer 2 bytes
 uint16_t spi_transfer9(uint16_t);   // SPI xfer 9 bits (courtesy for driving LCD screens)
+void spi_transfer_block(const uint8_t *tx, uint8_t *rx, uint8_t len);  // SPI xfer len bytes, full duplex
+void spi_write_block(const uint8_t *tx, uint8_t len);  // SPI xfer len bytes, SOMI data discarded
+void spi_read_block(uint8_t *rx, uint8_t len);         // SPI xfer len bytes clocking out 0xFF
+
+#ifdef REG_BENCHMARK
+extern uint16_t spi_bytes;  // Bytes clocked since the last reset of the count, see reg_bench.c
+#define SPI_COUNT(n) (spi_bytes += (n))
+#else
+#define SPI_COUNT(n)
+#endif
+
+#ifdef SPI_ASYNC
+/* Asynchronous transaction: CSN asserted, cmd sent, len bytes of tx (0xFF if tx is NULL)
+ * clocked out while len bytes are stored to rx (discarded if rx is NULL), CSN released.
+ * done() runs in interrupt context after CSN is released.
+ */
+typedef struct spi_xfer {
+	struct spi_xfer *next;
+	const uint8_t *tx;
+	uint8_t *rx;
+	uint8_t len;
+	uint8_t cmd;
+	uint8_t status;          // Byte clocked in alongside cmd (nRF24 STATUS)
+	volatile uint8_t busy;   // Set on submit, cleared on completion
+	void (*done)(struct spi_xfer *xfer);
+} SPI_XFER;
+
+extern SPI_XFER * volatile spi_xfer_head;
+
+void spi_async_submit(SPI_XFER *xfer);  // Queue transaction, starts immediately if the bus is idle
+uint8_t spi_async_isr();                // USCI_B0 RX interrupt body, returns 1 when a transaction finished
+void spi_async_drain();                 // Finish the queue by polling, from any context
+#define spi_async_idle() (spi_xfer_head == 0)
+#else
+#define spi_async_idle() 1
+#endif
 
 #endif
@@ -32,13 +32,24 @@
 #include "msp430_spi.h"
 #include "nRF24L01.h"
 #include "nrf_userconfig.h"
+#include "prof.h"
+#include "trace.h"
+#include "sched.h"
 /* ^ Provides nrfCSNport, nrfCSNportout, nrfCSNpin,
  nrfCEport, nrfCEportout, nrfCEpin,
  nrfIRQport, nrfIRQpin
  Also specify # clock cycles for 5ms, 10us and 130us sleeps.
  */
 /* Private library variables */
-uint8_t rf_feature;  // Used to track which features have been enabled
+/* RAM shadow of the writable configuration registers, kept current by w_reg() so
+ * read-modify-write setters and state queries don't have to read the chip back.
+ * Layout: CONFIG..RF_SETUP (0x00-0x06), RX_PW_P0..P5, DYNPD, FEATURE.
+ */
+static uint8_t rf_shadow[15];
+#define RF24_SHADOW_INDEX(addr) ((addr) <= RF24_RF_SETUP ? (addr) : \
+		(addr) <= RF24_RX_PW_P5 ? (addr) - RF24_RX_PW_P0 + 7 : (addr) - RF24_DYNPD + 13)
+#define rf_shadow_reg(addr) rf_shadow[RF24_SHADOW_INDEX(addr)]
+#define rf_feature rf_shadow_reg(RF24_FEATURE)  // Used to track which features have been enabled
 
 /* CE (Chip Enable/RF transceiver activate signal) and CSN (SPI chip-select) operations. */
 #define CSN_EN nrfCSNportout &= ~nrfCSNpin
@@ -46,21 +57,49 @@ uint8_t rf_feature;  // Used to track which features have been enabled
 #define CE_EN nrfCEportout |= nrfCEpin
 #define CE_DIS nrfCEportout &= ~nrfCEpin
 
+/* With SPI_ASYNC a queued transaction owns the bus and CSN until its done() has run.
+ * Synchronous I/O finishes the queue first.  It polls rather than sleeps, since the
+ * caller could be the ISR that has to finish it; a payload is 33 bytes at most.
+ */
+#ifdef SPI_ASYNC
+#define RF24_SYNC() spi_async_drain()
+#else
+#define RF24_SYNC()
+#endif
+
+#ifdef RF_TIMESTAMPS
+#if nrfIRQport != 2 || nrfIRQpin != BIT2
+#error "RF_TIMESTAMPS captures the IRQ on P2.2 (TA1.CCI1B)"
+#endif
+#if defined(TX_BENCHMARK) || defined(SPI_BENCHMARK)
+#error "RF_TIMESTAMPS keeps Timer1_A, the benchmarks need it"
+#endif
+#endif
+
 /* SPI drivers now supplied by msp430_spi.c */
 
 /* Basic I/O to the device. */
 uint8_t r_reg(uint8_t addr) {
 	uint16_t i;
 
+	RF24_SYNC();
+	PROF_BEGIN(PROF_R_REG);
 	CSN_EN;
 	i = spi_transfer16(RF24_NOP | ((addr & RF24_REGISTER_MASK) << 8));
 	rf_status = (uint8_t) ((i & 0xFF00) >> 8);
 	CSN_DIS;
+	PROF_END(PROF_R_REG);
 	return (uint8_t) (i & 0x00FF);
 }
 
 void w_reg(uint8_t addr, uint8_t data) {
 	uint16_t i;
+
+	RF24_SYNC();
+	addr &= RF24_REGISTER_MASK;
+	if (addr <= RF24_RF_SETUP || (addr >= RF24_RX_PW_P0 && addr <= RF24_RX_PW_P5)
+			|| addr == RF24_DYNPD || addr == RF24_FEATURE)
+		rf_shadow_reg(addr) = data;
 	CSN_EN;
 	i = spi_transfer16(
 			(data & 0x00FF)
@@ -72,6 +111,7 @@ void w_reg(uint8_t addr, uint8_t data) {
 void w_tx_addr(uint8_t *addr) {
 	int i;
 
+	RF24_SYNC();
 	CSN_EN;
 	rf_status = spi_transfer(RF24_TX_ADDR | RF24_W_REGISTER);
 	for (i = rf_addr_width - 1; i >= 0; i--) {
@@ -83,6 +123,7 @@ void w_tx_addr(uint8_t *addr) {
 void w_rx_addr(uint8_t pipe, uint8_t *addr) {
 	int i;
 
+	RF24_SYNC();
 	if (pipe > 5)
 		return;  // Only 6 pipes available
 	CSN_EN;
@@ -97,50 +138,42 @@ void w_rx_addr(uint8_t pipe, uint8_t *addr) {
 	CSN_DIS;
 }
 
-void w_tx_payload(uint8_t len, uint8_t *data) {
-	uint16_t i = 0;
+void w_tx_payload(uint8_t len, const uint8_t *data) {
+	RF24_SYNC();
+	PROF_BEGIN(PROF_W_TX_PAYLOAD);
 	CSN_EN;
-	if (len % 2) { // Odd payload size?  Make it even by stuffing the command in a 16-bit xfer
-		// Borrowing 'i' to extract STATUS...
-		i = spi_transfer16((RF24_W_TX_PAYLOAD << 8) | (0x00FF & data[0]));
-		rf_status = (i & 0xFF00) >> 8;
-		i = 1;
-		data[0] = 0;
-	} else {
-		rf_status = spi_transfer(RF24_W_TX_PAYLOAD);
-	}
-	for (; i < len; i += 2) {
-		// SPI transfers MSB first
-		spi_transfer16((data[i] << 8) | (0x00FF & data[i + 1]));
-		data[i] = data[i + 1] = 0;
-	}
+	rf_status = spi_transfer(RF24_W_TX_PAYLOAD);
+	spi_write_block(data, len);
 	CSN_DIS;
+	PROF_END(PROF_W_TX_PAYLOAD);
 }
 
-void w_tx_payload_noack(uint8_t len, uint8_t *data) {
-	uint16_t i = 0;
-
+void w_tx_payload_noack(uint8_t len, const uint8_t *data) {
+	RF24_SYNC();
 	if (!(rf_feature & RF24_EN_DYN_ACK)) // DYN ACK must be enabled to allow NOACK packets
 		return;
 	CSN_EN;
-	if (len % 2) {
-		// Borrowing 'i' to extract STATUS...
-		i = spi_transfer16((RF24_W_TX_PAYLOAD_NOACK << 8) | (0x00FF & data[0]));
-		rf_status = (i & 0xFF00) >> 8;
-		i = 1;
-	} else {
-		rf_status = spi_transfer(RF24_W_TX_PAYLOAD_NOACK);
-	}
-	for (; i < len; i += 2) {
-		// SPI transfers MSB first
-		spi_transfer16((data[i] << 8) | (0x00FF & data[i + 1]));
-	}
+	rf_status = spi_transfer(RF24_W_TX_PAYLOAD_NOACK);
+	spi_write_block(data, len);
+	CSN_DIS;
+}
+
+// Same with hdr sent ahead of data, so a caller adding a header byte needn't copy the payload
+void w_tx_payload_noack_hdr(uint8_t hdr, uint8_t len, const uint8_t *data) {
+	RF24_SYNC();
+	if (!(rf_feature & RF24_EN_DYN_ACK))
+		return;
+	CSN_EN;
+	rf_status = spi_transfer(RF24_W_TX_PAYLOAD_NOACK);
+	spi_transfer(hdr);
+	spi_write_block(data, len);
 	CSN_DIS;
 }
 
 uint8_t r_rx_peek_payload_size() {
 	uint16_t i;
 
+	RF24_SYNC();
 	CSN_EN;
 	i = spi_transfer16(RF24_NOP | (RF24_R_RX_PL_WID << 8));
 	rf_status = (uint8_t) ((i & 0xFF00) >> 8);
@@ -149,52 +182,87 @@ uint8_t r_rx_peek_payload_size() {
 }
 
 uint8_t r_rx_payload(uint8_t len, uint8_t *data) {
-	uint16_t i = 0, j;
+	RF24_SYNC();
 	CSN_EN;
-	if (len % 2) {
-		// Borrowing 'i' to extract STATUS...
-		i = spi_transfer16((RF24_R_RX_PAYLOAD << 8) | RF24_NOP);
-		rf_status = (i & 0xFF00) >> 8;
-		data[0] = i & 0x00FF;
-		i = 1;
-	} else {
-		rf_status = spi_transfer(RF24_R_RX_PAYLOAD);
-	}
-	for (; i < len; i += 2) {
-		j = spi_transfer16(0xFFFF);
-		// SPI transfers MSB first
-		data[i] = (j & 0xFF00) >> 8;
-		data[i + 1] = (j & 0x00FF);
-	}
+	rf_status = spi_transfer(RF24_R_RX_PAYLOAD);
+	spi_read_block(data, len);
 	CSN_DIS;
 	// The RX pipe this data belongs to is stored in STATUS
 	return ((rf_status & 0x0E) >> 1);
 }
 
+/* RX fast path for draining the whole FIFO per IRQ.  No NOP or FIFO_STATUS reads: the
+ * STATUS byte clocked out with R_RX_PL_WID already says whether the FIFO is empty
+ * (RX_P_NO = 7) and which pipe the payload at its head came in on.  Static-length
+ * pipes take their width from the register shadow.  Returns the length read into
+ * data (room for 32 bytes), 0 once the FIFO is empty, and stores the pipe in *pipe.
+ */
+uint8_t msprf24_rx_next(uint8_t *data, uint8_t *pipe) {
+	uint16_t i;
+	uint8_t len;
+
+	RF24_SYNC();
+	CSN_EN;
+	i = spi_transfer16(RF24_NOP | (RF24_R_RX_PL_WID << 8));
+	CSN_DIS;
+	rf_status = (uint8_t) ((i & 0xFF00) >> 8);
+	*pipe = (rf_status & 0x0E) >> 1;
+	if (*pipe > 5)
+		return 0;
+	if (rf_shadow_reg(RF24_DYNPD) & (1 << *pipe)) {
+		len = (uint8_t) (i & 0x00FF);
+		if (len > 32) {  // Corrupt width, the datasheet says to flush
+			flush_rx();
+			return 0;
+		}
+	} else {
+		len = rf_shadow_reg(RF24_RX_PW_P0 + *pipe);
+	}
+
+	CSN_EN;
+	spi_transfer(RF24_R_RX_PAYLOAD);
+	spi_read_block(data, len);
+	CSN_DIS;
+	return len;
+}
+
+/* Take every pending IRQ in one SPI transaction: the flags are cleared and the STATUS
+ * clocked out with the write is the reason.  Call it before draining with
+ * msprf24_rx_next() rather than after, so a payload landing after the last
+ * msprf24_rx_next() raises a fresh IRQ instead of having its RX_DR wiped.  rf_irq is
+ * dropped; RF24_IRQ_FLAGGED is only set again by an IRQ edge after this point.
+ */
+uint8_t msprf24_irq_take() {
+	RF24_SYNC();
+	rf_irq = 0x00;
+	CSN_EN;
+	rf_status = spi_transfer(RF24_STATUS | RF24_W_REGISTER);
+	spi_transfer(RF24_IRQ_MASK);
+	CSN_DIS;
+	return rf_status & RF24_IRQ_MASK;
+}
+
 void flush_tx() {
+	RF24_SYNC();
 	CSN_EN;
 	rf_status = spi_transfer(RF24_FLUSH_TX);
 	CSN_DIS;
 }
 
 void flush_rx() {
+	RF24_SYNC();
 	CSN_EN;
 	rf_status = spi_transfer(RF24_FLUSH_RX);
 	CSN_DIS;
 }
 
 void tx_reuse_lastpayload() {
+	RF24_SYNC();
 	CSN_EN;
 	rf_status = spi_transfer(RF24_REUSE_TX_PL);
 	CSN_DIS;
 }
 
-inline void pulse_ce() {
-	CE_EN;
-	__delay_cycles(DELAY_CYCLES_15US);
-	CE_DIS;
-}
-
 /* Used to manually ACK with a payload.  Must have RF24_EN_ACK_PAY enabled; this is not enabled by default
  * with msprf24_init() FYI.
  * When RF24_EN_ACK_PAY is enabled on the PTX side, ALL transmissions must be manually ACK'd by the receiver this way.
@@ -206,36 +274,71 @@ inline void pulse_ce() {
  * When this occurs, the PRX will still only notify its microcontroller of the payload once (the PID field in the packet uniquely
  * identifies it so the PRX knows it's the same packet being retransmitted) but it's obviously wasting on-air time (and power).
  */
-void w_ack_payload(uint8_t pipe, uint8_t len, uint8_t *data) {
-	uint16_t i = 0;
-	CSN_EN;
-
+void w_ack_payload(uint8_t pipe, uint8_t len, const uint8_t *data) {
+	RF24_SYNC();
 	if (pipe > 5)
 		return;
 	if (!(rf_feature & RF24_EN_ACK_PAY))  // ACK payloads must be enabled...
 		return;
 
-	if (len % 2) {
-		// Borrowing 'i' to extract STATUS...
-		i = spi_transfer16(
-				((RF24_W_ACK_PAYLOAD | pipe) << 8) | (0x00FF & data[0]));
-		rf_status = (i & 0xFF00) >> 8;
-		i = 1;
-	} else {
-		rf_status = spi_transfer(RF24_W_ACK_PAYLOAD | pipe);
-	}
-	for (; i < len; i += 2) {
-		// SPI transfers MSB first
-		spi_transfer16((data[i] << 8) | (0x00FF & data[i + 1]));
-	}
+	CSN_EN;
+	rf_status = spi_transfer(RF24_W_ACK_PAYLOAD | pipe);
+	spi_write_block(data, len);
 	CSN_DIS;
 }
 
+#ifdef SPI_ASYNC
+/* Interrupt-driven payload I/O.  A single transaction descriptor is shared by
+ * both directions; these return 0 without queueing anything if it is still busy.
+ * rf_status is updated before done() is called from interrupt context.
+ */
+static SPI_XFER rf_payload_xfer;
+static void (*rf_payload_done)();
+
+static void _msprf24_payload_done(SPI_XFER *xfer) {
+	rf_status = xfer->status;
+	if (rf_payload_done)
+		rf_payload_done();
+}
+
+uint8_t w_tx_payload_async(uint8_t len, const uint8_t *data, void (*done)()) {
+	if (rf_payload_xfer.busy)
+		return 0;
+	rf_payload_done = done;
+	rf_payload_xfer.cmd = RF24_W_TX_PAYLOAD;
+	rf_payload_xfer.tx = data;
+	rf_payload_xfer.rx = 0;
+	rf_payload_xfer.len = len;
+	rf_payload_xfer.done = _msprf24_payload_done;
+	spi_async_submit(&rf_payload_xfer);
+	return 1;
+}
+
+// RX pipe is available in done() as ((rf_status & 0x0E) >> 1)
+uint8_t r_rx_payload_async(uint8_t len, uint8_t *data, void (*done)()) {
+	if (rf_payload_xfer.busy)
+		return 0;
+	rf_payload_done = done;
+	rf_payload_xfer.cmd = RF24_R_RX_PAYLOAD;
+	rf_payload_xfer.tx = 0;
+	rf_payload_xfer.rx = data;
+	rf_payload_xfer.len = len;
+	rf_payload_xfer.done = _msprf24_payload_done;
+	spi_async_submit(&rf_payload_xfer);
+	return 1;
+}
+
+uint8_t msprf24_payload_busy() {
+	return rf_payload_xfer.busy;
+}
+#endif
+
 /* Configuration parameters used to set-up the RF configuration */
 uint8_t rf_crc;
 uint8_t rf_addr_width;
 uint8_t rf_speed_power;
 uint8_t rf_channel;
+uint8_t rf_ack_payload_len;
 /* Status variable updated every time SPI I/O is performed */
 uint8_t rf_status;
 /* IRQ state is stored in here after msprf24_get_irq_reason(), RF24_IRQ_FLAGGED raised during
@@ -244,8 +347,127 @@ uint8_t rf_status;
  */
 volatile uint8_t rf_irq;
 
+/* Timer-scheduled waits for the non-blocking init/power-up path.  Timer1_A CCR0 runs
+ * one-shot from ACLK so the MCU can sit in LPM3 while the transceiver settles.
+ */
+#define RF24_WAIT_NONE     0
+#define RF24_WAIT_INIT     1
+#define RF24_WAIT_POWERUP  2
+static volatile uint8_t rf_wait;
+static void (*rf_wait_done)();
+/* Set by msprf24_activate_tx() and pulse_ce(); the IRQ ISR drops CE once TX_DS/MAX_RT
+ * fires instead of spinning for the 10us CE pulse.
+ */
+static volatile uint8_t rf_ce_hold;
+
+#ifdef RF_TIMESTAMPS
+static volatile uint16_t rf_clock_hi;	// Timer1_A overflows
+static volatile uint8_t rf_wait_laps;	// full Timer1_A laps left in a wait
+static volatile uint32_t rf_stamp;
+uint32_t rf_tx_stamp;
+
+// Current timestamp clock, also right with interrupts off and an overflow pending
+uint32_t msprf24_clock() {
+	uint16_t state = __get_interrupt_state(), hi, lo;
+
+	_DINT();
+	hi = rf_clock_hi;
+	lo = TA1R;
+	if ((TA1CTL & TAIFG) && lo < 0x8000)
+		hi++;
+	__set_interrupt_state(state);
+	return (uint32_t)hi << 16 | lo;
+}
+
+uint32_t msprf24_irq_stamp() {
+	uint16_t state = __get_interrupt_state();
+	uint32_t stamp;
+
+	_DINT();
+	stamp = rf_stamp;
+	__set_interrupt_state(state);
+	return stamp;
+}
+#endif
+
+static void _msprf24_wait(uint8_t reason, uint16_t aclk_ticks, void (*done)()) {
+#ifdef RF_TIMESTAMPS
+	uint32_t smclk = (uint32_t)aclk_ticks * RF24_SMCLK_PER_ACLK;
+#endif
+
+	rf_wait = reason;
+	rf_wait_done = done;
+#ifdef RF_TIMESTAMPS
+	// Timer1_A keeps running: a compare smclk ticks out, in laps of 65536
+	rf_wait_laps = smclk >> 16;
+	if (!(uint16_t)smclk)
+		rf_wait_laps--;
+	TA1CCR0 = TA1R + (uint16_t)smclk;
+	TA1CCTL0 = CCIE;
+#else
+	TA1CCR0 = aclk_ticks;
+	TA1CCTL0 = CCIE;
+	TA1CTL = TASSEL_1 | ID_0 | MC_1 | TACLR;  // ACLK, up mode
+#endif
+}
+
+/* Blocking wrappers sleep here until the Timer1_A ISR finishes the wait.  sched_sleep()
+ * picks the LPM, so a held SMCLK (timer tick, UART, the RF_TIMESTAMPS clock) keeps running
+ * when this is called from a main loop handler.
+ */
+static void _msprf24_sleep_while_waiting() {
+	_DINT();
+	while (rf_wait != RF24_WAIT_NONE) {
+		sched_sleep();  // Sets GIE atomically with the sleep
+		_DINT();
+	}
+	_EINT();
+}
+
+uint8_t msprf24_async_busy() {
+	return rf_wait != RF24_WAIT_NONE;
+}
+
+/* Register setup half of msprf24_init(), once the transceiver has had 100ms to come
+ * out of reset.  Blocking SPI, so from the main loop only, never from an ISR.
+ */
+void msprf24_init_finish() {
+	uint8_t c;
+
+	// Configure RF transceiver with current value of rf_* configuration variables
+	msprf24_irq_clear(RF24_IRQ_MASK);  // Forget any outstanding IRQs
+	msprf24_close_pipe_all(); /* Start off with no pipes enabled, let the user open as needed.  This also
+	 * clears the DYNPD register.
+	 */
+	msprf24_set_retransmit_delay(0);  // Shortest safe delay for rf_speed_power and rf_ack_payload_len
+	msprf24_set_retransmit_count(10);    // A default I chose
+	msprf24_set_speed_power();
+	msprf24_set_channel();
+	msprf24_set_address_width();
+	for (c = 0; c < 6; c++)
+		w_reg(RF24_RX_PW_P0 + c, 0x00);  // Known values for the register shadow
+	w_reg(RF24_FEATURE, 0x00);  // Initialize this so we're starting from a clean slate
+	msprf24_enable_feature(RF24_EN_DPL); // Dynamic payload size capability (set with msprf24_set_pipe_packetsize(x, 0))
+	msprf24_enable_feature(RF24_EN_DYN_ACK); // Ability to use w_tx_payload_noack()
+
+	msprf24_powerdown();
+	flush_tx();
+	flush_rx();
+}
+
 /* Library functions */
 void msprf24_init() {
+	msprf24_init_async(0);
+	_msprf24_sleep_while_waiting();
+	msprf24_init_finish();
+}
+
+/* Set up pins and SPI, then return while the transceiver spends 100ms coming out of
+ * reset.  done() is called from the Timer1_A ISR when the time is up; it should only
+ * post an event, whose handler then calls msprf24_init_finish().  Don't touch the
+ * radio until that has run.
+ */
+void msprf24_init_async(void (*done)()) {
 	// Setup SPI
 	spi_init();
 	_EINT();  // Enable interrupts (set GIE in SR)
@@ -265,6 +487,14 @@ void msprf24_init() {
 	P2IES |= nrfIRQpin;   // Trigger on falling-edge
 	P2IFG &= ~nrfIRQpin;  // Clear any outstanding IRQ
 	P2IE |= nrfIRQpin;    // Enable IRQ interrupt
+#ifdef RF_TIMESTAMPS
+	// The edge goes to Timer1_A instead, T1A1_IRQ handles it
+	P2IE &= ~nrfIRQpin;
+	P2SEL |= nrfIRQpin;   // P2.2 -> TA1.CCI1B
+	P2SEL2 &= ~nrfIRQpin;
+	TA1CCTL1 = CM_2 | CCIS_1 | SCS | CAP | CCIE;  // Falling edge
+	TA1CTL = TASSEL_2 | ID_0 | MC_2 | TACLR | TAIE;  // SMCLK, continuous
+#endif
 #elif nrfIRQport == 3
 			P3DIR &= ~nrfIRQpin;  // IRQ line is input
 			P3OUT |= nrfIRQpin;// Pull-up resistor enabled
@@ -381,28 +611,7 @@ void msprf24_init() {
 	spi_transfer(RF24_NOP);
 
 	// Wait 100ms for RF transceiver to initialize.
-	uint8_t c = 20;
-	for (; c; c--) {
-		__delay_cycles(DELAY_CYCLES_5MS);
-	}
-
-	// Configure RF transceiver with current value of rf_* configuration variables
-	msprf24_irq_clear(RF24_IRQ_MASK);  // Forget any outstanding IRQs
-	msprf24_close_pipe_all(); /* Start off with no pipes enabled, let the user open as needed.  This also
-	 * clears the DYNPD register.
-	 */
-	msprf24_set_retransmit_delay(500);  // A default I chose
-	msprf24_set_retransmit_count(10);    // A default I chose
-	msprf24_set_speed_power();
-	msprf24_set_channel();
-	msprf24_set_address_width();
-	rf_feature = 0x00;  // Initialize this so we're starting from a clean slate
-	msprf24_enable_feature(RF24_EN_DPL); // Dynamic payload size capability (set with msprf24_set_pipe_packetsize(x, 0))
-	msprf24_enable_feature(RF24_EN_DYN_ACK); // Ability to use w_tx_payload_noack()
-
-	msprf24_powerdown();
-	flush_tx();
-	flush_rx();
+	_msprf24_wait(RF24_WAIT_INIT, DELAY_ACLK_100MS, done);
 }
 
 void msprf24_enable_feature(uint8_t feature) {
@@ -426,8 +635,8 @@ void msprf24_close_pipe(uint8_t pipeid) {
 	if (pipeid > 5)
 		return;
 
-	rxen = r_reg(RF24_EN_RXADDR);
-	enaa = r_reg(RF24_EN_AA);
+	rxen = rf_shadow_reg(RF24_EN_RXADDR);
+	enaa = rf_shadow_reg(RF24_EN_AA);
 
 	rxen &= ~(1 << pipeid);
 	enaa &= ~(1 << pipeid);
@@ -448,8 +657,8 @@ void msprf24_open_pipe(uint8_t pipeid, uint8_t autoack) {
 	if (pipeid > 5)
 		return;
 
-	rxen = r_reg(RF24_EN_RXADDR);
-	enaa = r_reg(RF24_EN_AA);
+	rxen = rf_shadow_reg(RF24_EN_RXADDR);
+	enaa = rf_shadow_reg(RF24_EN_AA);
 
 	if (autoack)
 		enaa |= (1 << pipeid);
@@ -466,7 +675,7 @@ uint8_t msprf24_pipe_isopen(uint8_t pipeid) {
 	if (pipeid > 5)
 		return 0;
 
-	rxen = r_reg(RF24_EN_RXADDR);
+	rxen = rf_shadow_reg(RF24_EN_RXADDR);
 
 	return ((1 << pipeid) == (rxen & (1 << pipeid)));
 }
@@ -477,7 +686,7 @@ void msprf24_set_pipe_packetsize(uint8_t pipe, uint8_t size) {
 	if (pipe > 5)
 		return;
 
-	dynpdcfg = r_reg(RF24_DYNPD);
+	dynpdcfg = rf_shadow_reg(RF24_DYNPD);
 	if (size < 1) {
 		if (!(rf_feature & RF24_EN_DPL)) // Cannot set dynamic payload if EN_DPL is disabled.
 			return;
@@ -494,20 +703,33 @@ void msprf24_set_pipe_packetsize(uint8_t pipe, uint8_t size) {
 	w_reg(RF24_DYNPD, dynpdcfg);
 }
 
+/* From the ACK payload tables in the nRF24L01+ datasheet (7.4.2): at 2Mbps a 250uS ARD
+ * fits up to 15 bytes of ACK payload, at 1Mbps up to 5 bytes, anything longer needs 500uS.
+ * At 250Kbps each 250uS step past 500uS buys 8 bytes.
+ */
+uint16_t msprf24_min_retransmit_delay() {
+	switch (rf_speed_power & RF24_SPEED_MASK) {
+	case RF24_SPEED_2MBPS:
+		return rf_ack_payload_len > 15 ? 500 : 250;
+	case RF24_SPEED_1MBPS:
+		return rf_ack_payload_len > 5 ? 500 : 250;
+	default:
+		if (rf_ack_payload_len > 24)
+			return 1500;
+		return 500 + 250 * ((rf_ack_payload_len + 7) / 8);
+	}
+}
+
 void msprf24_set_retransmit_delay(uint16_t us) {
 	uint8_t c;
 
-	// using 'c' to evaluate current RF speed
-	c = rf_speed_power & RF24_SPEED_MASK;
 	if (us > 4000)
 		us = 4000;
-	if (us < 1500 && c == RF24_SPEED_250KBPS)
-		us = 1500;
-	if (us < 500)
-		us = 500;
+	if (us < msprf24_min_retransmit_delay())
+		us = msprf24_min_retransmit_delay();
 
 	// using 'c' to save current value of ARC (auto-retrans-count) since we're not changing that here
-	c = r_reg(RF24_SETUP_RETR) & 0x0F;
+	c = rf_shadow_reg(RF24_SETUP_RETR) & 0x0F;
 	us = (us - 250) / 250;
 	us <<= 4;
 	w_reg(RF24_SETUP_RETR, c | (us & 0xF0));
@@ -516,7 +738,7 @@ void msprf24_set_retransmit_delay(uint16_t us) {
 void msprf24_set_retransmit_count(uint8_t count) {
 	uint8_t c;
 
-	c = r_reg(RF24_SETUP_RETR) & 0xF0;
+	c = rf_shadow_reg(RF24_SETUP_RETR) & 0xF0;
 	w_reg(RF24_SETUP_RETR, c | (count & 0x0F));
 }
 
@@ -546,7 +768,7 @@ uint8_t msprf24_is_alive() {
 uint8_t msprf24_set_config(uint8_t cfgval) {
 	uint8_t previous_config;
 
-	previous_config = r_reg(RF24_CONFIG);
+	previous_config = rf_shadow_reg(RF24_CONFIG);
 	w_reg(RF24_CONFIG, (_msprf24_crc_mask() | cfgval) & _msprf24_irq_mask());
 	return previous_config;
 }
@@ -555,6 +777,9 @@ void msprf24_set_speed_power() {
 	if ((rf_speed_power & RF24_SPEED_MASK) == RF24_SPEED_MASK) // Speed setting RF_DR_LOW=1, RF_DR_HIGH=1 is reserved, clamp it to minimum
 		rf_speed_power = (rf_speed_power & ~RF24_SPEED_MASK) | RF24_SPEED_MIN;
 	w_reg(RF24_RF_SETUP, (rf_speed_power & 0x2F));
+	// A slower rate may need a longer ARD than the current one; raise it if so
+	if ((rf_shadow_reg(RF24_SETUP_RETR) >> 4) * 250 + 250 < msprf24_min_retransmit_delay())
+		msprf24_set_retransmit_delay(0);
 }
 
 void msprf24_set_channel() {
@@ -589,24 +814,72 @@ uint8_t msprf24_current_state() {
 	return RF24_STATE_PRX;           // PWR_UP=1, PRIM_RX=1, CE=1 -- Must be PRX
 }
 
+/* Same as msprf24_current_state() but answered from the register shadow and the CE pin
+ * with no SPI traffic.  Chip presence is not checked, and PTX is reported whenever
+ * CE is high with PRIM_RX=0 since telling Standby-II apart needs a FIFO_STATUS read.
+ */
+uint8_t msprf24_cached_state() {
+	uint8_t config = rf_shadow_reg(RF24_CONFIG);
+
+	if ((config & RF24_PWR_UP) == 0x00)
+		return RF24_STATE_POWERDOWN;
+	if (!(nrfCEportout & nrfCEpin))
+		return RF24_STATE_STANDBY_I;
+	if (!(config & RF24_PRIM_RX))
+		return RF24_STATE_PTX;
+	if (rf_shadow_reg(RF24_RF_SETUP) & 0x90)
+		return RF24_STATE_TEST;
+	return RF24_STATE_PRX;
+}
+
+/* Diagnostics: read back every shadowed register and return the number that differ
+ * from the RAM copy (0 = shadow and chip agree).
+ */
+uint8_t msprf24_verify_shadow() {
+	uint8_t addr, errors = 0;
+
+	for (addr = RF24_CONFIG; addr <= RF24_FEATURE; addr++) {
+		if (addr == RF24_STATUS)
+			addr = RF24_RX_PW_P0;
+		else if (addr == RF24_FIFO_STATUS)
+			addr = RF24_DYNPD;
+		if (r_reg(addr) != rf_shadow_reg(addr))
+			errors++;
+	}
+	return errors;
+}
+
 // Power down device, 0.9uA power draw
 void msprf24_powerdown() {
 	CE_DIS;
+	rf_ce_hold = 0;
 	msprf24_set_config(0);  // PWR_UP=0
 }
 
 // Enable Standby-I, 26uA power draw
 void msprf24_standby() {
-	uint8_t state = msprf24_current_state();
-	if (state == RF24_STATE_NOTPRESENT || state == RF24_STATE_STANDBY_I)
-		return;
-	CE_DIS;
-	msprf24_set_config(RF24_PWR_UP);  // PWR_UP=1, PRIM_RX=0
-	if (state == RF24_STATE_POWERDOWN) { // If we're powering up from deep powerdown...
-		//CE_EN;  // This is a workaround for SI24R1 chips, though it seems to screw things up so disabled for now til I can obtain an SI24R1 for testing.
-		__delay_cycles(DELAY_CYCLES_5MS); // Then wait 5ms for the crystal oscillator to spin up.
-		//CE_DIS;
+	msprf24_standby_async(0);
+	_msprf24_sleep_while_waiting();
+}
+
+/* Enter Standby-I without blocking.  When powering up from deep powerdown the 5ms
+ * crystal start-up is timed by Timer1_A and done() is called from its ISR; otherwise
+ * done() is called before returning.
+ */
+void msprf24_standby_async(void (*done)()) {
+	uint8_t state = msprf24_cached_state();
+	if (state != RF24_STATE_STANDBY_I) {
+		CE_DIS;
+		rf_ce_hold = 0;
+		msprf24_set_config(RF24_PWR_UP);  // PWR_UP=1, PRIM_RX=0
+		if (state == RF24_STATE_POWERDOWN) { // If we're powering up from deep powerdown...
+			//CE_EN;  // This is a workaround for SI24R1 chips, though it seems to screw things up so disabled for now til I can obtain an SI24R1 for testing.
+			_msprf24_wait(RF24_WAIT_POWERUP, DELAY_ACLK_5MS, done); // Then wait 5ms for the crystal oscillator to spin up.
+			return;
+		}
 	}
+	if (done)
+		done();
 }
 
 // Enable PRX mode
@@ -618,6 +891,7 @@ void msprf24_activate_rx() {
 
 	// Enable PRIM_RX
 	msprf24_set_config(RF24_PWR_UP | RF24_PRIM_RX);
+	rf_ce_hold = 0;
 	CE_EN;
 	// 130uS required for PLL lock to stabilize, app can go do other things and wait
 	// for incoming I/O.
@@ -633,8 +907,36 @@ void msprf24_activate_tx() {
 	// Cancel any outstanding TX interrupt
 	w_reg(RF24_STATUS, RF24_TX_DS | RF24_MAX_RT);
 
-	// Pulse CE for 10us to activate PTX
-	pulse_ce();
+	// Raise CE to activate PTX; the IRQ ISR drops it again once the packet is done
+	rf_ce_hold = 1;
+	CE_EN;
+#ifdef RF_TIMESTAMPS
+	rf_tx_stamp = msprf24_clock();
+#endif
+}
+
+// Like activate_tx() without the standby, for resending after tx_reuse_lastpayload()
+void pulse_ce() {
+	rf_ce_hold = 1;
+	CE_EN;
+}
+
+/* Streaming PTX: CE is raised and left up, so the chip sends whatever is in the TX FIFO
+ *     back to back and idles in Standby-II when it runs dry instead of paying the
+ *     Standby-I -> TX settle for every packet.  Keep the FIFO topped up with w_tx_payload()
+ *     while RF24_QUEUE_TXFULL is clear; msprf24_standby() ends streaming.  TX_DS/MAX_RT
+ *     must be cleared by the app, MAX_RT stalls the FIFO until it is.
+ */
+void msprf24_stream_tx() {
+	if (msprf24_cached_state() != RF24_STATE_PTX) {
+		msprf24_standby();
+		w_reg(RF24_STATUS, RF24_TX_DS | RF24_MAX_RT);
+#ifdef RF_TIMESTAMPS
+		rf_tx_stamp = msprf24_clock();
+#endif
+	}
+	rf_ce_hold = 0;  // Also turns an activate_tx() pulse in progress into a stream
+	CE_EN;
 }
 
 /* Evaluate state of TX, RX FIFOs
@@ -652,25 +954,43 @@ uint8_t msprf24_scan() {
 	uint16_t rpdcount = 0;
 	uint8_t last_state;
 
-	last_state = msprf24_current_state();
+	last_state = msprf24_cached_state();
 	if (last_state != RF24_STATE_PRX)
 		msprf24_activate_rx();
 	for (; testcount > 0; testcount--) {
-		if (r_reg(RF24_RPD))
-			rpdcount++;
+		rpdcount += msprf24_scan_rpd();
 		__delay_cycles(DELAY_CYCLES_130US);
-		flush_rx();
-		w_reg(RF24_STATUS, RF24_RX_DR); /* Flush any RX FIFO contents or RX IRQs that
-		 * may have generated as a result of having PRX active.
-		 */
 	}
 	if (last_state != RF24_STATE_PRX)
 		msprf24_standby(); // If we weren't in RX mode before, leave it in Standby-I.
 	return ((uint8_t) (rpdcount / 4));
 }
 
+/* Retune an active PRX to channel ch for an RPD survey without touching rf_channel;
+ * restore the link channel afterwards with msprf24_set_channel().  RPD is valid
+ * once the receiver has been on-channel for ~170us.
+ */
+void msprf24_scan_tune(uint8_t ch) {
+	CE_DIS;
+	w_reg(RF24_RF_CH, ch & 0x7F);
+	CE_EN;
+}
+
+// Sample RPD (1 = signal > -64dBm seen), flushing the RX FIFO only if PRX actually received something
+uint8_t msprf24_scan_rpd() {
+	uint8_t rpd;
+
+	rpd = r_reg(RF24_RPD) & 0x01;
+	if (rf_status & RF24_RX_DR) {
+		flush_rx();
+		w_reg(RF24_STATUS, RF24_RX_DR);
+	}
+	return rpd;
+}
+
 // Check if there is pending RX fifo data
 uint8_t msprf24_rx_pending() {
+	RF24_SYNC();
 	CSN_EN;
 	rf_status = spi_transfer(RF24_NOP);
 	CSN_DIS;
@@ -684,6 +1004,7 @@ uint8_t msprf24_rx_pending() {
 uint8_t msprf24_get_irq_reason() {
 	uint8_t rf_irq_old = rf_irq;
 
+	RF24_SYNC();
 	//rf_irq &= ~RF24_IRQ_FLAGGED;  -- Removing in lieu of having this check determined at irq_clear() time
 	CSN_EN;
 	rf_status = spi_transfer(RF24_NOP);
@@ -696,6 +1017,7 @@ uint8_t msprf24_get_irq_reason() {
 void msprf24_irq_clear(uint8_t irqflag) {
 	uint8_t fifostat;
 
+	RF24_SYNC();
 	rf_irq = 0x00; // Clear IRQs; afterward analyze RX FIFO to see if we should re-set RX IRQ flag.
 	CSN_EN;
 	rf_status = spi_transfer(RF24_STATUS | RF24_W_REGISTER);
@@ -715,7 +1037,64 @@ void msprf24_irq_clear(uint8_t irqflag) {
 
 /*      -       -       Interrupt vectors       -       -       */
 
+// Timer1_A CCR0 one-shot ending a msprf24_*_async() wait
+#ifdef __GNUC__
+__attribute__((interrupt(TIMER1_A0_VECTOR)))
+void T1A0_WAIT (void) {
+#else
+#pragma vector = TIMER1_A0_VECTOR
+__interrupt void T1A0_WAIT(void) {
+#endif
+#ifdef RF_TIMESTAMPS
+	if (rf_wait_laps) {
+		rf_wait_laps--;
+		return;
+	}
+#else
+	TA1CTL = MC_0;
+#endif
+	TRACE_ISR(TRACE_RADIO_WAIT, rf_wait);
+	TA1CCTL0 = 0;
+	rf_wait = RF24_WAIT_NONE;
+	if (rf_wait_done)
+		rf_wait_done();
+	__bic_SR_register_on_exit(LPM4_bits);    // Wake up
+}
+
 // RF transceiver IRQ handling
+#ifdef RF_TIMESTAMPS
+// Timer1_A: the IRQ's falling edge captured in CCR1, or the timestamp clock overflowed
+#ifdef __GNUC__
+__attribute__((interrupt(TIMER1_A1_VECTOR)))
+void T1A1_IRQ (void) {
+#else
+#pragma vector = TIMER1_A1_VECTOR
+__interrupt void T1A1_IRQ(void) {
+#endif
+	uint16_t hi, lo;
+
+	switch (TA1IV) {
+	case TA1IV_TACCR1:
+		lo = TA1CCR1;
+		hi = rf_clock_hi;
+		if ((TA1CTL & TAIFG) && lo < 0x8000)
+			hi++;  // Captured after an overflow not counted yet
+		rf_stamp = (uint32_t)hi << 16 | lo;
+		TRACE_ISR(TRACE_RADIO_IRQ, 0);
+		__bic_SR_register_on_exit(LPM4_bits);    // Wake up
+		rf_irq |= RF24_IRQ_FLAGGED;
+		if (rf_ce_hold) {  // End of the PTX CE pulse
+			CE_DIS;
+			rf_ce_hold = 0;
+		}
+		break;
+	case TA1IV_TAIFG:
+		rf_clock_hi++;
+		break;
+	}
+}
+#endif
+
 #if   nrfIRQport == 2
 #ifdef __GNUC__
 __attribute__((interrupt(PORT2_VECTOR)))
@@ -725,8 +1104,13 @@ void P2_IRQ (void) {
 __interrupt void P2_IRQ(void) {
 #endif
 	if (P2IFG & nrfIRQpin) {
+		TRACE_ISR(TRACE_RADIO_IRQ, 0);
 		__bic_SR_register_on_exit(LPM4_bits);    // Wake up
 		rf_irq |= RF24_IRQ_FLAGGED;
+		if (rf_ce_hold) {  // End of the PTX CE pulse
+			CE_DIS;
+			rf_ce_hold = 0;
+		}
 		P2IFG &= ~nrfIRQpin;   // Clear interrupt flag
 	}
 }
@@ -740,8 +1124,13 @@ void P1_IRQ (void) {
 	__interrupt void P1_IRQ (void) {
 #endif
 		if(P1IFG & nrfIRQpin) {
+			TRACE_ISR(TRACE_RADIO_IRQ, 0);
 			__bic_SR_register_on_exit(LPM4_bits);
 			rf_irq |= RF24_IRQ_FLAGGED;
+			if (rf_ce_hold) {  // End of the PTX CE pulse
+				CE_DIS;
+				rf_ce_hold = 0;
+			}
 			P1IFG &= ~nrfIRQpin;
 		}
 	}
@@ -757,6 +1146,10 @@ void P1_IRQ (void) {
 			if (P3IFG & nrfIRQpin) {
 				__bic_SR_register_on_exit(LPM4_bits);
 				rf_irq |= RF24_IRQ_FLAGGED;
+				if (rf_ce_hold) {  // End of the PTX CE pulse
+					CE_DIS;
+					rf_ce_hold = 0;
+				}
 				P3IFG &= ~nrfIRQpin;
 			}
 		}
@@ -772,6 +1165,10 @@ void P1_IRQ (void) {
 				if (P4IFG & nrfIRQpin) {
 					__bic_SR_register_on_exit(LPM4_bits);
 					rf_irq |= RF24_IRQ_FLAGGED;
+					if (rf_ce_hold) {  // End of the PTX CE pulse
+						CE_DIS;
+						rf_ce_hold = 0;
+					}
 					P4IFG &= ~nrfIRQpin;
 				}
 			}
@@ -787,6 +1184,10 @@ void P1_IRQ (void) {
 					if (P5IFG & nrfIRQpin) {
 						__bic_SR_register_on_exit(LPM4_bits);
 						rf_irq |= RF24_IRQ_FLAGGED;
+						if (rf_ce_hold) {  // End of the PTX CE pulse
+							CE_DIS;
+							rf_ce_hold = 0;
+						}
 						P5IFG &= ~nrfIRQpin;
 					}
 				}
@@ -802,6 +1203,10 @@ void P1_IRQ (void) {
 						if (P6IFG & nrfIRQpin) {
 							__bic_SR_register_on_exit(LPM4_bits);
 							rf_irq |= RF24_IRQ_FLAGGED;
+							if (rf_ce_hold) {  // End of the PTX CE pulse
+								CE_DIS;
+								rf_ce_hold = 0;
+							}
 							P6IFG &= ~nrfIRQpin;
 						}
 					}
@@ -817,6 +1222,10 @@ void P1_IRQ (void) {
 							if (P7IFG & nrfIRQpin) {
 								__bic_SR_register_on_exit(LPM4_bits);
 								rf_irq |= RF24_IRQ_FLAGGED;
+								if (rf_ce_hold) {  // End of the PTX CE pulse
+									CE_DIS;
+									rf_ce_hold = 0;
+								}
 								P7IFG &= ~nrfIRQpin;
 							}
 						}
@@ -832,6 +1241,10 @@ void P1_IRQ (void) {
 								if (P8IFG & nrfIRQpin) {
 									__bic_SR_register_on_exit(LPM4_bits);
 									rf_irq |= RF24_IRQ_FLAGGED;
+									if (rf_ce_hold) {  // End of the PTX CE pulse
+										CE_DIS;
+										rf_ce_hold = 0;
+									}
 									P8IFG &= ~nrfIRQpin;
 								}
 							}
@@ -847,6 +1260,10 @@ void P1_IRQ (void) {
 									if (P9IFG & nrfIRQpin) {
 										__bic_SR_register_on_exit(LPM4_bits);
 										rf_irq |= RF24_IRQ_FLAGGED;
+										if (rf_ce_hold) {  // End of the PTX CE pulse
+											CE_DIS;
+											rf_ce_hold = 0;
+										}
 										P9IFG &= ~nrfIRQpin;
 									}
 								}
@@ -862,6 +1279,10 @@ void P1_IRQ (void) {
 										if (P10IFG & nrfIRQpin) {
 											__bic_SR_register_on_exit(LPM4_bits);
 											rf_irq |= RF24_IRQ_FLAGGED;
+											if (rf_ce_hold) {  // End of the PTX CE pulse
+												CE_DIS;
+												rf_ce_hold = 0;
+											}
 											P10IFG &= ~nrfIRQpin;
 										}
 									}
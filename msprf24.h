@@ -22,6 +22,7 @@
 
 #include <stdint.h>
 #include "nRF24L01.h"
+#include "nrf_userconfig.h"
 
 /* Configuration variables used to tune RF settings during initialization and for
  * runtime reconfiguration.  You should define all 4 of these before running msprf24_init();
@@ -30,6 +31,10 @@ extern uint8_t rf_crc;
 extern uint8_t rf_addr_width;
 extern uint8_t rf_speed_power;
 extern uint8_t rf_channel;
+/* Longest ACK payload the PTX expects back (0-32), sets the shortest safe auto-retransmit delay.
+ * Leave at 0 unless RF24_EN_ACK_PAY is in use.
+ */
+extern uint8_t rf_ack_payload_len;
 
 /* Status variable updated every time SPI I/O is performed */
 extern uint8_t rf_status;
@@ -38,6 +43,15 @@ extern uint8_t rf_status;
  */
 extern volatile uint8_t rf_irq;
 
+#ifdef RF_TIMESTAMPS
+/* RF24_STAMP_HZ clock of the IRQ timestamps (Timer1_A, extended to 32 bits).  The stamp
+ * is when the IRQ line last fell; events that come while it is still low share it.
+ */
+extern uint32_t rf_tx_stamp;	// when CE last went up for a transmission
+uint32_t msprf24_clock();
+uint32_t msprf24_irq_stamp();
+#endif
+
 /* RF speed settings -- nRF24L01+ compliant, older nRF24L01 does not have 2Mbps. */
 #define RF24_SPEED_250KBPS  0x20
 #define RF24_SPEED_1MBPS    0x00
@@ -91,25 +105,41 @@ void spi_init();
 uint8_t spi_transfer(uint8_t);  // SPI xfer 1 byte
 uint16_t spi_transfer16(uint16_t);  // SPI xfer 2 bytes
 uint16_t spi_transfer9(uint16_t);   // SPI xfer 9 bits (courtesy for driving LCD screens)
+void spi_write_block(const uint8_t *tx, uint8_t len);  // SPI xfer len bytes, SOMI data discarded
+void spi_read_block(uint8_t *rx, uint8_t len);         // SPI xfer len bytes clocking out 0xFF
 */
 // Register & FIFO I/O
 uint8_t r_reg(uint8_t addr);
 void w_reg(uint8_t addr, uint8_t data);
 void w_tx_addr(uint8_t *addr);             // Configure TX address to send next packet
 void w_rx_addr(uint8_t pipe, uint8_t *addr);  // Configure RX address of "rf_addr_width" size into the specified pipe
-void w_tx_payload(uint8_t len, uint8_t *data);
-void w_tx_payload_noack(uint8_t len, uint8_t *data);  /* Only used in auto-ack mode with RF24_EN_DYN_ACK enabled;
+void w_tx_payload(uint8_t len, const uint8_t *data);
+void w_tx_payload_noack(uint8_t len, const uint8_t *data);  /* Only used in auto-ack mode with RF24_EN_DYN_ACK enabled;
 						 * send this packet with no auto-ack.
 						 */
+void w_tx_payload_noack_hdr(uint8_t hdr, uint8_t len, const uint8_t *data);  // hdr, then len bytes of data (1 + len on air)
 uint8_t r_rx_peek_payload_size();  // Peek size of incoming RX payload
 uint8_t r_rx_payload(uint8_t len, uint8_t *data);
+uint8_t msprf24_rx_next(uint8_t *data, uint8_t *pipe);  /* Read the next RX payload, 0 if the FIFO is empty; pipe from RX_P_NO.
+							 * Loop until 0 after msprf24_irq_take() to drain the FIFO per IRQ.
+							 */
 void flush_tx();
 void flush_rx();
 void tx_reuse_lastpayload();   /* Enable retransmitting contents of TX FIFO endlessly until flush_tx() or the FIFO contents are replaced.
 				* Actual retransmits don't occur until CE pin is strobed using pulse_ce();
 				*/
-void pulse_ce();  // Pulse CE pin to activate retransmission of TX FIFO contents after tx_reuse_lastpayload();
-void w_ack_payload(uint8_t pipe, uint8_t len, uint8_t *data);  // Used when RF24_EN_ACK_PAY is enabled to manually ACK a received packet
+void pulse_ce();  // Raise CE to retransmit the TX FIFO contents after tx_reuse_lastpayload(); the IRQ drops it again
+void w_ack_payload(uint8_t pipe, uint8_t len, const uint8_t *data);  // Used when RF24_EN_ACK_PAY is enabled to manually ACK a received packet
+
+#ifdef SPI_ASYNC
+/* Interrupt-driven payload I/O; done() is called from interrupt context.  Return 0 if a payload
+ * transfer is already in flight.  Every other call here finishes the transfer first (by
+ * polling, done() runs from there), so they can be mixed freely.
+ */
+uint8_t w_tx_payload_async(uint8_t len, const uint8_t *data, void (*done)());
+uint8_t r_rx_payload_async(uint8_t len, uint8_t *data, void (*done)());
+uint8_t msprf24_payload_busy();  // Async payload transfer still in flight?
+#endif
 
 
 
@@ -117,12 +147,18 @@ void w_ack_payload(uint8_t pipe, uint8_t len, uint8_t *data);  // Used when RF24
 void msprf24_init();  /* Set the various configuration variables before running this.
 		       * It will populate the channel/speed/power/default features/etc. values
 		       */
+void msprf24_init_async(void (*done)());  /* Same as msprf24_init() but returns during the 100ms reset wait;
+					   * done() is called from the Timer1_A ISR when it is over.
+					   */
+void msprf24_init_finish();  // After msprf24_init_async()'s done(): the register setup, from the main loop
+uint8_t msprf24_async_busy();        // Is an msprf24_*_async() wait still in progress?
 void msprf24_close_pipe(uint8_t pipeid);       // Disable specified RX pipe
 void msprf24_close_pipe_all();                       // Disable all RX pipes (used during initialization)
 void msprf24_open_pipe(uint8_t pipeid, uint8_t autoack); // Enable specified RX pipe, optionally turn auto-ack (Enhanced ShockBurst) on
 uint8_t msprf24_pipe_isopen(uint8_t pipeid); // Check if specified RX pipe is active
 void msprf24_set_pipe_packetsize(uint8_t pipe, uint8_t size);  // Set static length of pipe's RX payloads (1-32), size=0 enables DynPD.
-void msprf24_set_retransmit_delay(uint16_t us);           // 500-4000uS range, clamped by RF speed
+void msprf24_set_retransmit_delay(uint16_t us);           // 250-4000uS range, clamped by RF speed and rf_ack_payload_len
+uint16_t msprf24_min_retransmit_delay();        // Shortest ARD that still receives the ACK at the current speed/ACK payload length
 void msprf24_set_retransmit_count(uint8_t count);       // 0-15 retransmits before MAX_RT (RF24_IRQ_TXFAILED) IRQ raised
 uint8_t msprf24_get_last_retransmits();        // # times a packet was retransmitted during last TX attempt
 uint8_t msprf24_get_lostpackets();      /* # of packets lost since last time the Channel was set.
@@ -138,12 +174,18 @@ void msprf24_disable_feature(uint8_t feature);   /* Disable specified feature
 
 // Change chip state and activate I/O
 uint8_t msprf24_current_state();    // Get current state of the nRF24L01+ chip, test with RF24_STATE_* #define's
+uint8_t msprf24_cached_state();     // Same, from the register shadow with no SPI I/O (no NOTPRESENT, STANDBY_II reads as PTX)
+uint8_t msprf24_verify_shadow();    // Compare register shadow against the chip, returns # of mismatched registers
 void msprf24_powerdown();                 // Enter Power-Down mode (0.9uA power draw)
 void msprf24_standby();                   // Enter Standby-I mode (26uA power draw)
+void msprf24_standby_async(void (*done)());  // Enter Standby-I, done() runs once the 5ms power-up wait (if any) is over
 void msprf24_activate_rx();               // Enable PRX mode (~12-14mA power draw)
 void msprf24_activate_tx();               // Enable Standby-II or PTX mode; TX FIFO contents will be sent over the air (~320uA STBY2, 7-11mA PTX)
+void msprf24_stream_tx();                 // Same, but CE stays high until msprf24_standby() so refills go out back to back
 uint8_t msprf24_queue_state();      // Read FIFO_STATUS register; user should compare return value with RF24_QUEUE_* #define's
 uint8_t msprf24_scan();             // Scan current channel for RPD (looks for any signals > -64dBm)
+void msprf24_scan_tune(uint8_t ch);  // Retune active PRX to another channel for surveys (rf_channel untouched)
+uint8_t msprf24_scan_rpd();         // Single RPD sample, 1 if a signal > -64dBm is present
 
 // IRQ handling
 uint8_t msprf24_rx_pending();		   /* Query STATUS register to determine if RX FIFO data is available for reading. */
@@ -151,6 +193,7 @@ uint8_t msprf24_get_irq_reason();            /* Query STATUS register for the IR
 						    * Result is stored in rf_irq (note- RF24_IRQ_FLAGGED is not automatically cleared by this
 						    * function, that's the user's responsibility.)
 						    */
+uint8_t msprf24_irq_take();                 // Clear all IRQ flags, returning the ones that were set (RF24_IRQ_*), one SPI transaction
 void msprf24_irq_clear(uint8_t irqflag);     /* Clear specified Interrupt Flags (RF24_IRQ_* #define's) from the transceiver.
 		 				    * Required to allow further transmissions to continue.
 						    */
@@ -10,9 +10,23 @@
 #include "msprf24.h"
 #include "nrf_userconfig.h"
 #include "interrupts.h"
+#include "events.h"
+#include "uart.h"
+#include "bridge.h"
 #include "stdint.h"
+#include "log.h"
+#include "trace.h"
+#include <string.h>
+#ifdef TX_BENCHMARK
+#include "tx_bench.h"
+#endif
+#ifdef SPI_BENCHMARK
+#include "spi_bench.h"
+#endif
+#ifdef REG_BENCHMARK
+#include "reg_bench.h"
+#endif
 
-volatile BUFFER buffer;
 volatile unsigned int user;
 
 //private globals
@@ -22,6 +36,218 @@ uint8_t retransmits = 0;
 uint16_t lost_packets = 0;
 uint8_t connected = 0;
 
+// Radio bring-up runs in timed steps, see radio_ready()
+#define RADIO_INIT_WAIT		0
+#define RADIO_POWERUP_WAIT	1
+#define RADIO_READY			2
+#define RADIO_PAUSED		3
+static uint8_t radio_step = RADIO_INIT_WAIT;
+#define radio_goto(step)	do { radio_step = (step); TRACE(TRACE_RADIO_STEP, step); } while (0)
+static RF_MODE stream_mode;
+static uint8_t stream_open = 0;
+
+/* Adaptive frequency hopping.  Both ends share hop_table.  The PTX scores each
+ * channel from ARC_CNT/MAX_RT, blacklists bad ones and announces a hop to the PRX
+ * with a LINK_CMD_HOP frame before moving.  If the link is lost anyway the PTX
+ * walks the whole table quickly (HOP_FAIL_LIMIT failures per channel) while the
+ * PRX, after HOP_RESYNC_PINGS quiet ping periods, walks it slowly so the two meet.
+ */
+static const uint8_t hop_table[HOP_CHANNELS] = { 120, 76, 2, 100, 86, 26, 110, 50 };
+static uint8_t hop_score[HOP_CHANNELS];	// EWMA x8 of per-packet retransmit cost, stops at 255
+static uint8_t hop_blacklist = 0;			// bit per hop_table entry
+static uint8_t hop_index = 0;
+static uint8_t hop_fails = 0;				// consecutive MAX_RT on this channel
+static uint8_t hop_idle = 0;				// PRX: ping periods without traffic
+
+/* Rate/power adaptation.  The PTX sums ARC_CNT and MAX_RT over RATE_WINDOW packets
+ * and moves one level more robust when a window is bad, one level cheaper after
+ * RATE_DOWN_WINDOWS calm windows.  The PRX follows a LINK_CMD_RATE frame; the PTX
+ * only switches once that frame is ACKed.  On link loss both ends fall back to
+ * RATE_FALLBACK so the hop resync can find the other side.
+ */
+static const uint8_t rate_table[RATE_LEVELS] = {
+	RF24_SPEED_2MBPS | RF24_POWER_MINUS18DBM,
+	RF24_SPEED_2MBPS | RF24_POWER_MINUS12DBM,
+	RF24_SPEED_2MBPS | RF24_POWER_MINUS6DBM,
+	RF24_SPEED_2MBPS | RF24_POWER_0DBM,
+	RF24_SPEED_1MBPS | RF24_POWER_0DBM,
+	RF24_SPEED_250KBPS | RF24_POWER_0DBM
+};
+static uint8_t rate_level = RATE_DEFAULT;
+static uint8_t rate_count = 0;				// packets in this window
+static uint8_t rate_fails = 0;
+static uint16_t rate_arc = 0;
+static uint8_t rate_calm = 0;				// consecutive calm windows
+static uint32_t rate_bytes = 0;				// payload bytes ACKed at this level
+static uint16_t rate_since = 0;				// tics when this level was entered
+
+static uint8_t ard_margin = 0;				// ARD steps above msprf24_min_retransmit_delay()
+
+static uint8_t link_pending = LINK_CMD_NONE;	// PTX: control frame queued, data held back until it is done
+static uint8_t link_pending_arg;
+static uint8_t link_sent = 0;				// PTX: link_pending is on the air
+
+/* Packets waiting on the radio or the UART live in pkt_pool, queued through pkt_next.
+ * A node is either PTX (tx_queue) or PRX (rx_queue per pipe), so one pool serves both.
+ * Received payloads are read straight into a slot and the UART sends them from there;
+ * the slot is only freed once its last byte has left.  With no slot free, payloads stay
+ * in the chip (rx_stalled): once its FIFO is full it stops ACKing and the PTX retries.
+ */
+typedef struct {
+	uint8_t head;
+	uint8_t tail;
+	uint8_t count;
+} PKT_QUEUE;
+
+static BUFFER pkt_pool[PKT_POOL_SIZE];
+static uint8_t pkt_next[PKT_POOL_SIZE];
+static uint8_t pkt_free;
+static uint8_t pkt_avail;					// slots on the free list
+static uint8_t rx_stalled = 0;				// payloads left in the RX FIFO for want of a slot
+uint16_t pkt_exhausted = 0;					// times the pool was too full to take a payload/message
+uint8_t pkt_high_water = 0;					// most slots in use at once
+
+/* PTX packets: TX_STREAM_MODE queues in tx_queue and keeps the chip's FIFO full with CE
+ * held high; TX_MODE writes straight to the FIFO and pulses CE per packet.  Both record
+ * the length of each payload in the FIFO so ACKed bytes can be credited in order.
+ */
+static PKT_QUEUE tx_queue;
+static uint8_t stream_slot;					// slot the bridge is filling, see radio_stream_buf()
+static uint8_t tx_fifo_len[TX_FIFO_DEPTH];
+static uint8_t tx_fifo_head = 0;
+static uint8_t tx_fifo_count = 0;
+uint16_t tx_dropped = 0;					// TX_STREAM_MODE: packets refused, queue full
+uint8_t rx_batch_max = 0;					// most payloads drained on a single IRQ
+#ifdef RF_TIMESTAMPS
+uint32_t tx_stamp = 0;						// IRQ stamp of the latest TX_DS/MAX_RT
+uint32_t tx_airtime = 0;					// RF24_STAMP_HZ ticks from CE (or the previous completion) to TX_DS/MAX_RT, summed
+#endif
+
+/* PRX packets wait in rx_queue for the UART.  radio_rx_drain() serves the pipes round
+ * robin one whole packet at a time, a packet the UART can't take at once is finished
+ * (rx_off) before moving on.
+ */
+static PKT_QUEUE rx_queue[RX_PIPES];
+
+/* PRX downlink: radio_send() queues in ack_queue, ack_fill() loads one ACK payload per
+ * pipe into the chip.  A packet received on a pipe took that pipe's payload with its ACK.
+ */
+static PKT_QUEUE ack_queue;
+static uint8_t pkt_pipe[PKT_POOL_SIZE];		// ack_queue: pipe each packet is for
+static uint8_t ack_loaded = 0;				// bit per pipe: ACK payload waiting in the TX FIFO
+static uint8_t rx_turn = 0;					// pipe radio_rx_drain() serves next
+static uint8_t rx_lent = 0;					// that pipe's head packet is with the UART
+PIPE_STATS pipe_stats[RX_PIPES];
+static uint8_t hub_node = 0;				// PTX: hub pipe we send to, 0 = point to point link
+
+/* Messages being received go to the pipe's rx_queue a fragment at a time; rx_next is
+ * the header (less MSG_LAST) the pipe's next fragment has to carry.
+ */
+#define MSG_FRESH	0xFF					// rx_next: between messages
+static uint8_t rx_next[RX_PIPES];
+static COBS_STATE rx_cobs[RX_PIPES];		// MSG_COBS stream per pipe
+static uint8_t msg_id = 0;					// id of the next message sent
+uint16_t msg_dropped = 0;					// incomplete messages given up on
+
+/* The message being sent, one at a time: msg_feed() copies its fragments from the
+ * caller's buffer into pool slots as they free up, nothing else is queued meanwhile.
+ */
+static const uint8_t *msg_data = 0;			// rest of it, 0 once every fragment is queued
+static uint8_t msg_left;
+static uint8_t msg_hdr;						// header of its next fragment, less MSG_LAST
+static uint8_t msg_pipe;					// PRX: pipe whose ACKs carry it
+static uint8_t tx_last_hdr = MSG_LAST;		// PTX: header of the last payload in the FIFO, MSG_LAST if none
+
+#ifdef RF_BULK
+/* Bulk transfer, PTX side: round 0 sends every packet, later rounds only what the PRX
+ * listed as missing in its report (bulk_nack).
+ */
+#define BULK_IDLE	0
+#define BULK_START	1		// LINK_CMD_BULK on the air
+#define BULK_DATA	2		// NOACK packets streaming
+#define BULK_POLL	3		// asking for the NACK report
+static uint8_t bulk_state = BULK_IDLE;
+static const uint8_t *bulk_data;
+static uint16_t bulk_len;
+static uint8_t bulk_packets;
+static uint8_t bulk_round;
+static uint8_t bulk_pos;					// next packet (round 0) or bulk_nack entry to send
+static uint8_t bulk_nack[ACK_PAYLOAD_MAX - 2];
+static uint8_t bulk_nack_count;				// entries in bulk_nack, BULK_MORE if the report was cut short
+static uint8_t bulk_report_ok;				// report for bulk_round arrived with the last poll
+static uint8_t bulk_tries;
+uint16_t bulk_resent = 0;					// packets sent again after a NACK, last transfer
+#ifdef TX_BENCHMARK
+static uint32_t bulk_started;
+#endif
+
+/* Bulk transfer, PRX side: one bit per packet received (delivered or held), packets
+ * go out the UART in order with up to BULK_HOLD held back waiting for a gap.
+ */
+static uint8_t bulk_map[BULK_MAX_PACKETS / 8];
+static uint8_t bulk_rx_packets = 0;			// packets in the current transfer, 0 = none
+static uint8_t bulk_rx_next;				// next packet to go to the UART
+static PKT_QUEUE bulk_held;
+#define bulk_active()	(bulk_state != BULK_IDLE)
+#else
+#define bulk_active()	0
+#endif
+
+static void pkt_init() {
+	uint8_t i;
+
+	for (i = 0; i < PKT_POOL_SIZE; i++)
+		pkt_next[i] = i + 1 < PKT_POOL_SIZE ? i + 1 : PKT_NONE;
+	pkt_free = 0;
+	pkt_avail = PKT_POOL_SIZE;
+	stream_slot = PKT_NONE;
+	memset(rx_next, MSG_FRESH, sizeof(rx_next));
+	msg_data = 0;
+	tx_last_hdr = MSG_LAST;
+}
+
+static uint8_t pkt_alloc() {
+	uint8_t i = pkt_free;
+
+	if (i != PKT_NONE) {
+		pkt_free = pkt_next[i];
+		pkt_avail--;
+		if (PKT_POOL_SIZE - pkt_avail > pkt_high_water)
+			pkt_high_water = PKT_POOL_SIZE - pkt_avail;
+	}
+	return i;
+}
+
+static void pkt_release(uint8_t i) {
+	pkt_next[i] = pkt_free;
+	pkt_free = i;
+	pkt_avail++;
+	if (rx_stalled)
+		rf_irq |= RF24_IRQ_FLAGGED;  // Run recieve_bytes() again for what is waiting in the chip
+}
+
+static void pkt_push(PKT_QUEUE *q, uint8_t i) {
+	pkt_next[i] = PKT_NONE;
+	if (q->count)
+		pkt_next[q->tail] = i;
+	else
+		q->head = i;
+	q->tail = i;
+	q->count++;
+}
+
+static uint8_t pkt_pop(PKT_QUEUE *q) {
+	uint8_t i = q->head;
+
+	q->head = pkt_next[i];
+	q->count--;
+	return i;
+}
+
+static uint8_t stream_rx() {
+	return stream_mode == RX_MODE || stream_mode == RX_HUB_MODE;
+}
+
 inline void reset_connected() {
 	connected = 0;
 }
@@ -30,58 +256,920 @@ uint8_t is_connected() {
 	return connected;
 }
 
-void transmit_bytes() {
-	// size 0 indicates dynamic size; must be specified using
-	//transmit_Xbytes(); 32 is max
-	if (payload_size > 32)
+// Pipe 0/TX address of link control frames
+static void link_ctrl_addr(uint8_t *ctrl) {
+	uint8_t i;
+
+	for (i = 0; i < 5; i++)
+		ctrl[i] = addr[i];
+	ctrl[4] ^= 0xFF;
+}
+
+static void hop_to(uint8_t index) {
+	hop_index = index;
+	hop_fails = 0;
+	rf_channel = hop_table[index];
+	if (stream_rx()) {
+		msprf24_standby();
+		msprf24_set_channel();
+		msprf24_activate_rx();
+	} else {
+		msprf24_standby();  // CE may be held high by TX_STREAM_MODE
+		msprf24_set_channel();
+	}
+}
+
+// Next hop_table entry not blacklisted; the blacklist is forgotten if everything is on it
+static uint8_t hop_next_good() {
+	uint8_t i, next = hop_index;
+
+	for (i = 0; i < HOP_CHANNELS; i++) {
+		next = (next + 1) % HOP_CHANNELS;
+		if (!(hop_blacklist & (1 << next)))
+			return next;
+	}
+	hop_blacklist = 0;
+	return (hop_index + 1) % HOP_CHANNELS;
+}
+
+/* Pick ARD/ARC from the current speed, ACK payload length and the rate window stats.
+ * ARD stays at the shortest delay that still receives the ACK unless MAX_RT shows up
+ * while most packets needed no retransmit at all -- loss in bursts, so space retries
+ * out.  ARC gives twice the window's average retransmit count plus some headroom, so a
+ * dead link doesn't burn 15 retries per packet while a noisy one still gets through.
+ */
+static void link_tune_retransmit() {
+	uint8_t arc;
+
+	if (rate_count) {
+		if (rate_fails && rate_arc < rate_count) {
+			if (ard_margin < ARD_MAX_MARGIN)
+				ard_margin++;
+		} else if (ard_margin) {
+			ard_margin--;
+		}
+		arc = ARC_MIN + (2 * rate_arc + rate_count - 1) / rate_count + 2 * rate_fails;
+	} else {
+		arc = ARC_MAX;  // No stats yet (new level or fresh link), be generous
+	}
+	if (arc > ARC_MAX)
+		arc = ARC_MAX;
+	msprf24_set_retransmit_delay(msprf24_min_retransmit_delay() + ard_margin * ARD_STEP);
+	msprf24_set_retransmit_count(arc);
+}
+
+// Report goodput of the level being left, then switch speed/power
+static void rate_apply(uint8_t level) {
+	uint16_t secs = tics - rate_since;
+	uint32_t goodput;
+
+	if (level == rate_level)
 		return;
-	else if (payload_size == 0)
-		w_tx_payload(buffer.size, buffer.buf);
+	goodput = rate_bytes / (secs ? secs : 1);
+	LOG(LOG_RATE, rate_level, LOG_U32(goodput));
+	rate_level = level;
+	rate_bytes = 0;
+	rate_since = tics;
+	rate_count = rate_fails = rate_calm = 0;
+	rate_arc = 0;
+
+	rf_speed_power = rate_table[level];
+	if (stream_rx()) {
+		msprf24_standby();
+		msprf24_set_speed_power();
+		msprf24_activate_rx();
+	} else {
+		msprf24_standby();
+		msprf24_set_speed_power();
+		link_tune_retransmit();
+	}
+}
+
+static void tx_start() {
+	if (stream_mode == TX_STREAM_MODE)
+		msprf24_stream_tx();
 	else
-		w_tx_payload(payload_size, buffer.buf);
+		msprf24_activate_tx();
+}
 
-	msprf24_activate_tx();
-	retransmits = msprf24_get_last_retransmits();
+static void tx_fifo_push(uint8_t len) {
+	tx_fifo_len[(tx_fifo_head + tx_fifo_count) % TX_FIFO_DEPTH] = len;
+	tx_fifo_count++;
 }
 
-// Recieves packets, loading into buffer.buf.  buffer.size contains
-// size of payload, 0 if none recieved succesfully.
-void recieve_bytes() {
-	if (payload_size > 0)
-		buffer.size = payload_size;
+// Oldest payload in the FIFO is done with, returns its length
+static uint8_t tx_fifo_pop() {
+	uint8_t len;
+
+	if (!tx_fifo_count)
+		return 0;
+	len = tx_fifo_len[tx_fifo_head];
+	tx_fifo_head = (tx_fifo_head + 1) % TX_FIFO_DEPTH;
+	tx_fifo_count--;
+	return len;
+}
+
+// Put the pending control frame on the air; TX_ADDR points at the control pipe until it is done
+static void link_ctrl_flush() {
+	uint8_t ctrl[5];
+	uint8_t frame[2];
+
+	link_ctrl_addr(ctrl);
+	w_tx_addr(ctrl);
+	w_rx_addr(0, ctrl);
+	frame[0] = link_pending;
+	frame[1] = link_pending_arg;
+	w_tx_payload(2, frame);
+	link_sent = 1;
+	tx_start();
+}
+
+/* PTX: send a control frame to the PRX, the matching change happens on the TX result.
+ * Data still in the FIFO goes out first; tx_queue is held back meanwhile.
+ */
+static void link_ctrl_send(uint8_t cmd, uint8_t arg) {
+	link_pending = cmd;
+	link_pending_arg = arg;
+	link_sent = 0;
+	if (!tx_fifo_count)
+		link_ctrl_flush();
+}
+
+#ifdef RF_BULK
+// Bulk data address: the control pipe's with bit 0 flipped; pipe 2 only has its own LSB
+static void link_bulk_addr(uint8_t *bulk) {
+	link_ctrl_addr(bulk);
+	bulk[4] ^= 0x01;
+}
+
+// PTX: keep the FIFO full of NOACK packets for this round
+static void bulk_fill() {
+	uint8_t seq, len;
+	uint16_t off;
+
+	while (tx_fifo_count < TX_FIFO_DEPTH) {
+		if (bulk_round == 0) {
+			if (bulk_pos >= bulk_packets)
+				break;
+			seq = bulk_pos++;
+		} else {
+			if (bulk_pos >= (bulk_nack_count & ~BULK_MORE))
+				break;
+			seq = bulk_nack[bulk_pos++];
+			bulk_resent++;
+		}
+		off = (uint16_t) seq * BULK_CHUNK;
+		len = bulk_len - off < BULK_CHUNK ? bulk_len - off : BULK_CHUNK;
+		w_tx_payload_noack_hdr(seq, len, bulk_data + off);  // Straight from the source, no copy
+		tx_fifo_push(len + 1);
+	}
+	if (tx_fifo_count)
+		msprf24_stream_tx();
+}
+
+static void bulk_round_start() {
+	uint8_t bulk[5];
+
+	link_bulk_addr(bulk);
+	w_tx_addr(bulk);
+	bulk_state = BULK_DATA;
+	bulk_pos = 0;
+	bulk_fill();
+}
+
+static void bulk_finish(uint8_t ok) {
+#ifdef TX_BENCHMARK
+	uint32_t us = tx_bench_clock() - bulk_started;
+
+	LOG(LOG_BULK, ok ? bulk_len : 0, LOG_U32(us), bulk_resent);
+	tx_bench_clock_stop();
+#endif
+	bulk_state = BULK_IDLE;  // tx_done() picks up queued traffic again
+}
+
+// PTX: a LINK_CMD_BULK or LINK_CMD_BULK_POLL frame is done
+static void bulk_ctrl_done(uint8_t cmd, uint8_t failed) {
+	if (cmd == LINK_CMD_BULK && !failed) {
+		bulk_tries = 0;
+		bulk_round_start();
+		return;
+	}
+	if (cmd == LINK_CMD_BULK_POLL && bulk_report_ok) {
+		bulk_report_ok = 0;
+		bulk_tries = 0;
+		if (!bulk_nack_count) {
+			bulk_finish(1);
+		} else {
+			bulk_round++;
+			bulk_round_start();
+		}
+		return;
+	}
+	// Lost, or the PRX hadn't loaded the report yet: ask again
+	if (++bulk_tries >= BULK_TRIES)
+		bulk_finish(0);
 	else
-		buffer.size = r_rx_peek_payload_size();
+		link_ctrl_send(cmd, cmd == LINK_CMD_BULK ? bulk_packets : bulk_round);
+}
 
-	msprf24_get_irq_reason();
-	if (rf_irq & RF24_IRQ_RX) {
-		r_rx_payload(buffer.size, buffer.buf);
-		msprf24_irq_clear(RF24_IRQ_RX);
-		connected = 1;
+// PTX: TX_DS while streaming bulk data; no ACKs, so no link statistics either
+static void bulk_tx_done() {
+	if (msprf24_queue_state() & RF24_QUEUE_TXEMPTY)
+		tx_fifo_count = 0;
+	else
+		tx_fifo_pop();
+	bulk_fill();
+	if (tx_fifo_count)
 		return;
-	} else if (rf_irq & RF24_IRQ_TX) {
-		connected = 1;
-	} else if (rf_irq & RF24_IRQ_TXFAILED) {
-		connected = 0;
+	// Round is out, go and ask what is missing
+	msprf24_standby();
+	w_tx_addr(addr);
+	bulk_state = BULK_POLL;
+	link_ctrl_send(LINK_CMD_BULK_POLL, bulk_round);
+}
+
+// PTX: ACK payload of a LINK_CMD_BULK_POLL
+static void bulk_report(BUFFER *b) {
+	if (b->size < 2 || b->buf[0] != bulk_round || (b->buf[1] & ~BULK_MORE) > sizeof(bulk_nack))
+		return;  // Stale, from an earlier poll
+	bulk_nack_count = b->buf[1];
+	memcpy(bulk_nack, b->buf + 2, bulk_nack_count & ~BULK_MORE);
+	bulk_report_ok = 1;
+}
+#endif
+
+static void link_ctrl_done(uint8_t failed) {
+	uint8_t cmd = link_pending;
+
+	link_pending = LINK_CMD_NONE;
+	link_sent = 0;
+	w_tx_addr(addr);
+	w_rx_addr(0, addr);
+	if (cmd == LINK_CMD_HOP)
+		hop_to(link_pending_arg);  // move even if the ACK was lost, the PRX resyncs if needed
+	else if (cmd == LINK_CMD_RATE && !failed)
+		rate_apply(link_pending_arg);
+#ifdef RF_BULK
+	else if (cmd == LINK_CMD_BULK || cmd == LINK_CMD_BULK_POLL)
+		bulk_ctrl_done(cmd, failed);
+#endif
+}
+
+// PTX: one rate evaluation window is complete
+static void rate_evaluate() {
+	link_tune_retransmit();
+	if (hub_node) {
+		// The hub serves other nodes too, speed and channel are its call
+	} else if (rate_fails >= RATE_UP_FAILS || rate_arc >= RATE_UP_ARC) {
+		rate_calm = 0;
+		if (rate_level < RATE_LEVELS - 1)
+			link_ctrl_send(LINK_CMD_RATE, rate_level + 1);
+	} else if (!rate_fails && rate_arc <= RATE_DOWN_ARC) {
+		if (++rate_calm >= RATE_DOWN_WINDOWS && rate_level > 0) {
+			rate_calm = 0;
+			link_ctrl_send(LINK_CMD_RATE, rate_level - 1);
+		}
+	} else {
+		rate_calm = 0;
 	}
-	msprf24_irq_clear(RF24_IRQ_RX);
-	buffer.size = 0;
-	return;
+	rate_count = rate_fails = 0;
+	rate_arc = 0;
 }
 
-void open_tx_stream() {
-	msprf24_set_pipe_packetsize(0, 0);
-	msprf24_open_pipe(0, 1);  // Open pipe#0 with Enhanced ShockBurst
+// PTX: account for one TX attempt on the current channel and rate level
+static void link_tx_result(uint8_t arc, uint8_t failed) {
+	uint8_t *score = &hop_score[hop_index];
+	uint16_t s = *score - (*score >> 3) + (failed ? HOP_FAIL_PENALTY : arc << 2);
 
-	msprf24_standby();
+	*score = s > 0xFF ? 0xFF : s;  // Well past HOP_BAD_SCORE, more would only slow recovery
 
-//	user = msprf24_current_state();
+	if (link_sent) {
+		link_ctrl_done(failed);
+		return;
+	}
+	rate_arc += arc;
+	rate_fails += failed;
+	if (failed) {
+		tx_fifo_count = 0;  // Flushed along with the failed payload
+		if (++hop_fails >= HOP_FAIL_LIMIT && !hub_node) {
+			hop_blacklist |= 1 << hop_index;
+			hop_to((hop_index + 1) % HOP_CHANNELS);  // lost: walk every channel
+			rate_apply(RATE_FALLBACK);
+		}
+	} else {
+		hop_fails = 0;
+		rate_bytes += tx_fifo_pop();
+		if (*score > HOP_BAD_SCORE && !hub_node) {
+			hop_blacklist |= 1 << hop_index;
+			link_ctrl_send(LINK_CMD_HOP, hop_next_good());
+			return;
+		}
+	}
+	if (++rate_count >= RATE_WINDOW)
+		rate_evaluate();
 }
 
-void open_rx_stream() {
-	msprf24_set_pipe_packetsize(0, 0);
-	msprf24_open_pipe(0, 1);  // Open pipe#0 with Enhanced ShockBurst
+// Once per ping period: age channel scores, let the PRX go looking for a lost PTX
+void link_tick() {
+	uint8_t i;
 
-	msprf24_standby();
+	if (radio_step != RADIO_READY)
+		return;
+	for (i = 0; i < HOP_CHANNELS; i++) {
+		if (i == hop_index)
+			continue;
+		hop_score[i] -= hop_score[i] >> 2;
+		if (hop_score[i] < HOP_GOOD_SCORE)
+			hop_blacklist &= ~(1 << i);
+	}
+	// Not a hub: it owns its channel and rate, the sensor nodes come to it
+	if (stream_mode == RX_MODE && ++hop_idle >= HOP_RESYNC_PINGS) {
+		hop_idle = 0;
+		rate_apply(RATE_FALLBACK);
+		hop_to((hop_index + 1) % HOP_CHANNELS);
+	}
+}
+
+#ifdef SPI_ASYNC
+/* PTX: the slot whose payload is being written by interrupt-driven SPI, held until
+ * RF_WRITTEN_EVENT.  Meanwhile the main loop sleeps in LPM1 (see sched_sleep()).
+ */
+static uint8_t tx_writing = PKT_NONE;
+
+static void tx_written() {
+	sched_post_isr(RF_WRITTEN_EVENT);
+}
+#endif
+
+/* Copy fragments of the message being sent into free slots, keeping keep slots back for
+ * what is received meanwhile.
+ */
+static void msg_feed(uint8_t keep) {
+	BUFFER *b;
+	uint8_t i, chunk = stream_rx() ? ACK_PAYLOAD_MAX - 1 : MSG_CHUNK;
+
+	while (msg_data && pkt_avail > keep) {
+		i = pkt_alloc();
+		b = &pkt_pool[i];
+		b->size = msg_left < chunk ? msg_left : chunk;
+		memcpy(b->buf + 1, msg_data, b->size);
+		msg_data += b->size;
+		msg_left -= b->size;
+		b->buf[0] = msg_hdr | (msg_left ? 0 : MSG_LAST);
+		b->size++;
+		msg_hdr = (msg_hdr & ~MSG_INDEX) | ((msg_hdr + 1) & MSG_INDEX);
+		if (!msg_left)
+			msg_data = 0;
+		if (stream_rx()) {
+			pkt_pipe[i] = msg_pipe;
+			pkt_push(&ack_queue, i);
+		} else {
+			pkt_push(&tx_queue, i);
+		}
+		keep = 1;
+	}
+}
+
+// PTX: move queued packets into the FIFO while it has room (one at a time in TX_MODE)
+static void tx_fill() {
+	BUFFER *b;
+	uint8_t i, depth, written = 0;
+
+	if (link_pending != LINK_CMD_NONE || bulk_active() || radio_step != RADIO_READY)
+		return;
+#ifdef SPI_ASYNC
+	if (tx_writing != PKT_NONE)
+		return;  // radio_tx_written() carries on
+#endif
+	depth = stream_mode == TX_STREAM_MODE ? TX_FIFO_DEPTH : 1;
+	while (tx_fifo_count < depth) {
+		msg_feed(1);
+		if (!tx_queue.count)
+			break;
+		i = pkt_pop(&tx_queue);
+		b = &pkt_pool[i];
+		tx_fifo_push(b->size);
+		tx_last_hdr = b->buf[0];
+#ifdef SPI_ASYNC
+		/* CE goes up first: with the FIFO empty the chip waits in Standby-II and sends as
+		 * soon as the payload is in, and any register access finishes the write anyway.
+		 */
+		tx_start();
+		tx_writing = i;
+		w_tx_payload_async(b->size, b->buf, tx_written);
+		return;
+#else
+		w_tx_payload(b->size, b->buf);
+		pkt_release(i);
+		written = 1;
+#endif
+	}
+	if (written)
+		tx_start();
+}
+
+#ifdef SPI_ASYNC
+// RF_WRITTEN_EVENT: tx_fill()'s payload is in the FIFO, the slot is free for the next one
+void radio_tx_written() {
+	if (tx_writing == PKT_NONE)
+		return;
+	pkt_release(tx_writing);
+	tx_writing = PKT_NONE;
+	tx_fill();
+}
+#endif
+
+// PRX: load queued downlink packets as ACK payloads, one per pipe, order kept per pipe
+static void ack_fill() {
+	BUFFER *b;
+	uint8_t i, pipe, n;
+
+	msg_feed(1);
+	n = ack_queue.count;
+	while (n--) {
+		i = pkt_pop(&ack_queue);
+		pipe = pkt_pipe[i];
+		if (!(ack_loaded & (1 << pipe)) && !(msprf24_queue_state() & RF24_QUEUE_TXFULL)) {
+			b = &pkt_pool[i];
+			w_ack_payload(pipe, b->size, b->buf);
+			ack_loaded |= 1 << pipe;
+			pkt_release(i);
+		} else {
+			pkt_push(&ack_queue, i);
+		}
+	}
+}
+
+/* PTX: after TX_DS/MAX_RT has been accounted for.  TX_DS may stand for more than one
+ * packet, FIFO_STATUS tells us when everything written has gone.
+ */
+static void tx_done() {
+	if (tx_fifo_count && (msprf24_queue_state() & RF24_QUEUE_TXEMPTY)) {
+		while (tx_fifo_count)
+			rate_bytes += tx_fifo_pop();
+		tx_last_hdr = MSG_LAST;  // All of it made it
+	}
+	if (link_pending != LINK_CMD_NONE) {
+		if (!link_sent && !tx_fifo_count)
+			link_ctrl_flush();
+	} else {
+		tx_fill();
+		if (stream_mode == TX_STREAM_MODE && !tx_fifo_count)
+			msprf24_standby();  // Nothing left, no point idling in Standby-II
+	}
+}
+
+// Slots have come free, or a message was started: carry on sending
+static void msg_pump() {
+	if (stream_rx())
+		ack_fill();
+	else
+		tx_fill();
+}
+
+// Start sending a message, flags go into every header; its first fragment is queued at once
+static uint8_t msg_send(uint8_t pipe, const uint8_t *data, uint16_t len, uint8_t flags) {
+	if (radio_step != RADIO_READY || !len || len > MSG_MAX || msg_data || (stream_rx() && pipe >= RX_PIPES))
+		return 0;
+	if (!pkt_avail) {
+		pkt_exhausted++;
+		return 0;
+	}
+	msg_data = data;
+	msg_left = len;
+	msg_pipe = pipe;
+	msg_hdr = msg_id | flags;
+	msg_id = (msg_id + MSG_ID_STEP) & MSG_ID;
+	msg_feed(0);
+	msg_pump();
+	return 1;
+}
+
+/* Send a message of up to MSG_MAX bytes to the other end of the link; the same call on
+ * either side.  PTX: sent as ordinary packets, pipe is ignored.  PRX: carried back
+ * ACK_PAYLOAD_MAX bytes at a time on the ACKs of packets received on pipe, with no
+ * PRX/PTX role swap.  Either way it arrives on the other end's pipe 0 (the PTX gets ACK
+ * payloads there) and goes out its UART in order.  Only a fragment's worth is copied
+ * right away, the rest is read from data as the pool drains: data has to stay put until
+ * radio_send_busy() clears.  Returns 0 if it could not be started.
+ */
+uint8_t radio_send(uint8_t pipe, const uint8_t *data, uint16_t len) {
+	return msg_send(pipe, data, len, 0);
+}
+
+// A message is still being read from the caller's buffer; radio_send() refuses another
+uint8_t radio_send_busy() {
+	return msg_data != 0;
+}
+
+/* PTX: a pool slot for the bridge to gather up to MSG_CHUNK bytes of COBS encoded serial
+ * stream in place, so they aren't held twice.  The same slot until radio_stream_send();
+ * 0 if the pool is empty, a message is being sent or this end is the PRX.
+ */
+uint8_t *radio_stream_buf() {
+	if (stream_slot == PKT_NONE) {
+		if (radio_step != RADIO_READY || stream_rx() || msg_data)
+			return 0;
+		stream_slot = pkt_alloc();
+		if (stream_slot == PKT_NONE) {
+			pkt_exhausted++;
+			return 0;
+		}
+	}
+	return pkt_pool[stream_slot].buf + 1;
+}
+
+// Queue the slot as a single fragment message of len bytes; 0 hands it back unsent
+void radio_stream_send(uint8_t len) {
+	BUFFER *b = &pkt_pool[stream_slot];
+
+	if (!len) {
+		pkt_release(stream_slot);
+	} else {
+		b->size = len + 1;
+		b->buf[0] = msg_id | MSG_COBS | MSG_LAST;
+		msg_id = (msg_id + MSG_ID_STEP) & MSG_ID;
+		pkt_push(&tx_queue, stream_slot);
+		tx_fill();
+	}
+	stream_slot = PKT_NONE;
+}
+
+/* PTX: the FIFO was flushed.  If that cut a message short, the rest of it is useless:
+ * its queued fragments go, and so does what was still to come from the caller's buffer.
+ */
+static void msg_drop_orphans() {
+	uint8_t i, hdr = 0;
+
+	if (tx_last_hdr & MSG_LAST)
+		return;
+	tx_last_hdr = MSG_LAST;
+	while (tx_queue.count && !(hdr & MSG_LAST)) {
+		i = pkt_pop(&tx_queue);
+		hdr = pkt_pool[i].buf[0];
+		pkt_release(i);
+	}
+	if (!(hdr & MSG_LAST))
+		msg_data = 0;
+	msg_dropped++;
+}
+
+#ifdef RF_BULK
+/* PTX: send len bytes (up to BULK_MAX_PACKETS * BULK_CHUNK) as a NOACK bulk transfer.
+ * data is read again for retransmits, so it has to stay put until bulk_busy() clears;
+ * flash (log dumps, calibration tables) is the intended source.  Normal traffic waits
+ * in the send queue meanwhile.  Returns 0 if a transfer or link control is under way.
+ */
+uint8_t bulk_send(const uint8_t *data, uint16_t len) {
+	if (stream_rx() || hub_node || radio_step != RADIO_READY || bulk_state != BULK_IDLE
+			|| link_pending != LINK_CMD_NONE || !len || len > BULK_MAX_PACKETS * BULK_CHUNK)
+		return 0;
+	bulk_data = data;
+	bulk_len = len;
+	bulk_packets = (len + BULK_CHUNK - 1) / BULK_CHUNK;
+	bulk_round = 0;
+	bulk_tries = 0;
+	bulk_report_ok = 0;
+	bulk_resent = 0;
+#ifdef TX_BENCHMARK
+	tx_bench_clock_start();
+	bulk_started = tx_bench_clock();
+#endif
+	bulk_state = BULK_START;
+	link_ctrl_send(LINK_CMD_BULK, bulk_packets);
+	return 1;
+}
+
+uint8_t bulk_busy() {
+	return bulk_state != BULK_IDLE;
+}
+#endif
+
+// Send len bytes of data; payload_size other than 0 fixes the length (data must hold that many)
+void transmit_bytes(const char *data, uint8_t len) {
+	if (radio_step != RADIO_READY)
+		return;
+	if (payload_size)
+		len = payload_size;
+	if (!radio_send(0, (const uint8_t *)data, len))
+		tx_dropped++;
+}
+
+#ifdef RF_BULK
+// PRX: LINK_CMD_BULK, forget any earlier transfer
+static void bulk_rx_start(uint8_t packets) {
+	memset(bulk_map, 0, sizeof(bulk_map));
+	while (bulk_held.count)
+		pkt_release(pkt_pop(&bulk_held));
+	bulk_rx_packets = packets;
+	bulk_rx_next = 0;
+}
+
+// PRX: LINK_CMD_BULK_POLL, load the NACK report for the poll that follows
+static void bulk_rx_report(uint8_t round) {
+	uint8_t report[ACK_PAYLOAD_MAX];
+	uint8_t seq, n = 0;
+
+	report[1] = 0;
+	for (seq = bulk_rx_next; seq < bulk_rx_packets; seq++) {
+		if (bulk_map[seq >> 3] & (1 << (seq & 7)))
+			continue;
+		if (n == sizeof(report) - 2) {
+			report[1] = BULK_MORE;
+			break;
+		}
+		report[2 + n++] = seq;
+	}
+	report[0] = round;
+	report[1] |= n;
+	if (!(ack_loaded & (1 << LINK_CTRL_PIPE)) && !(msprf24_queue_state() & RF24_QUEUE_TXFULL)) {
+		w_ack_payload(LINK_CTRL_PIPE, n + 2, report);
+		ack_loaded |= 1 << LINK_CTRL_PIPE;
+	}
+}
+
+// PRX: in-order bulk packet, queue it for the UART; each one stands alone there
+static void bulk_rx_deliver(uint8_t i) {
+	pkt_pool[i].buf[0] = MSG_LAST;  // The sequence number has done its job, it becomes the header
+	pkt_push(&rx_queue[BULK_PIPE], i);
+	bulk_rx_next++;
+}
+
+/* PRX: bulk data packet in slot i.  Returns 1 if the slot was taken; a packet that isn't
+ * (duplicate, no room to hold it) stays unmarked and is NACKed.
+ */
+static uint8_t bulk_rx(uint8_t i, BUFFER *b) {
+	uint8_t seq = b->buf[0], n, j, found;
+
+	if (b->size < 2 || seq >= bulk_rx_packets || (bulk_map[seq >> 3] & (1 << (seq & 7))))
+		return 0;
+	if (seq != bulk_rx_next) {
+		if (bulk_held.count >= BULK_HOLD)
+			return 0;
+		bulk_map[seq >> 3] |= 1 << (seq & 7);
+		pkt_push(&bulk_held, i);
+		return 1;
+	}
+	bulk_map[seq >> 3] |= 1 << (seq & 7);
+	bulk_rx_deliver(i);
+	do {  // Held packets the gap was holding up
+		found = 0;
+		for (n = bulk_held.count; n; n--) {
+			j = pkt_pop(&bulk_held);
+			if (pkt_pool[j].buf[0] == bulk_rx_next) {
+				bulk_rx_deliver(j);
+				found = 1;
+			} else {
+				pkt_push(&bulk_held, j);
+			}
+		}
+	} while (found);
+	sched_post(UART_TX_EVENT);
+	return 1;
+}
+#endif
+
+/* Fragment in slot i to the UART queue.  Bridge stream is decoded
+ * in place first, a fragment that decodes to nothing (delimiters) isn't worth a trip.
+ */
+static void msg_deliver(uint8_t pipe, uint8_t i) {
+	BUFFER *b = &pkt_pool[i];
+
+	if (b->buf[0] & MSG_COBS) {
+		b->size = 1 + cobs_decode(&rx_cobs[pipe], b->buf + 1, b->size - 1);
+		if (b->size == 1) {
+			pkt_release(i);
+			return;
+		}
+	}
+	pkt_push(&rx_queue[pipe], i);
+}
+
+/* A fragment of pipe's message went missing.  Its fragments still in rx_queue are
+ * dropped, but for one the UART is sending already, which ends it instead; those to
+ * come are refused.
+ */
+static void msg_cut(uint8_t pipe) {
+	PKT_QUEUE *q = &rx_queue[pipe];
+	uint8_t i, next, n, keep = 0;
+
+	rx_next[pipe] = MSG_FRESH;
+	msg_dropped++;
+	for (i = q->head, n = 1; n <= q->count; i = pkt_next[i], n++) {
+		if (pkt_pool[i].buf[0] & MSG_LAST)
+			keep = n;  // Earlier messages are whole
+	}
+	if (!keep && q->count && rx_lent && rx_turn == pipe) {
+		keep = 1;
+		pkt_pool[q->head].buf[0] |= MSG_LAST;
+	}
+	if (keep == q->count)
+		return;
+	if (!keep) {
+		while (q->count)
+			pkt_release(pkt_pop(q));
+		return;
+	}
+	for (i = q->head, n = 1; n < keep; n++)
+		i = pkt_next[i];
+	q->tail = i;
+	for (i = pkt_next[i]; q->count > keep; i = next, q->count--) {
+		next = pkt_next[i];
+		pkt_release(i);
+	}
+}
+
+/* Data fragment in slot i, queued for the UART right away if it follows on from what
+ * the pipe has had so far.  If it doesn't, the message in progress lost a fragment and
+ * is cut short.  Returns 1 if slot i was taken.
+ */
+static uint8_t msg_rx(uint8_t pipe, uint8_t i) {
+	uint8_t hdr = pkt_pool[i].buf[0];
+
+	if (pkt_pool[i].size < 2)
+		return 0;
+	if (rx_next[pipe] != MSG_FRESH && (hdr & ~MSG_LAST) != rx_next[pipe])
+		msg_cut(pipe);
+	if (rx_next[pipe] == MSG_FRESH && (hdr & MSG_INDEX))
+		return 0;  // Tail of a message whose start was lost
+	if (hdr & MSG_LAST)
+		rx_next[pipe] = MSG_FRESH;
+	else
+		rx_next[pipe] = (hdr & ~MSG_INDEX) | ((hdr + 1) & MSG_INDEX);
+	msg_deliver(pipe, i);
+	sched_post(UART_TX_EVENT);
+	return 1;
+}
+
+/* One received payload in slot i of pkt_pool: link control is acted on, data is queued
+ * for the UART.  Returns 1 if slot i was queued.
+ */
+static uint8_t rx_deliver(uint8_t pipe, uint8_t i) {
+	BUFFER *b = &pkt_pool[i];
+	PIPE_STATS *stats;
+
+#ifdef RF_BULK
+	if (link_sent && link_pending == LINK_CMD_BULK_POLL) {
+		bulk_report(b);  // PTX: this ACK payload answers the poll
+		return 0;
+	}
+#endif
+	ack_loaded &= ~(1 << pipe);  // Its ACK carried any payload loaded for this pipe
+	if (pipe == LINK_CTRL_PIPE && stream_mode == RX_MODE) {
+		if (b->buf[0] == LINK_CMD_HOP && b->buf[1] < HOP_CHANNELS)
+			hop_to(b->buf[1]);
+		else if (b->buf[0] == LINK_CMD_RATE && b->buf[1] < RATE_LEVELS)
+			rate_apply(b->buf[1]);
+#ifdef RF_BULK
+		else if (b->buf[0] == LINK_CMD_BULK && b->buf[1] <= BULK_MAX_PACKETS)
+			bulk_rx_start(b->buf[1]);
+		else if (b->buf[0] == LINK_CMD_BULK_POLL)
+			bulk_rx_report(b->buf[1]);
+#endif
+		return 0;
+	}
+	if (pipe >= RX_PIPES)
+		return 0;  // Not opened in this build
+	stats = &pipe_stats[pipe];
+	stats->packets++;
+	stats->bytes += b->size;
+	rate_bytes += b->size;
+#ifdef RF_BULK
+	if (pipe == BULK_PIPE && stream_mode == RX_MODE) {
+		if (bulk_rx(i, b))
+			return 1;
+		stats->dropped++;
+		return 0;
+	}
+#endif
+	if (stream_mode == RX_HUB_MODE && rx_queue[pipe].count >= HUB_PIPE_SLOTS) {
+		if (rx_next[pipe] != MSG_FRESH)
+			msg_cut(pipe);  // This fragment leaves a hole in the message
+		stats->dropped++;
+		return 0;
+	}
+	if (msg_rx(pipe, i))
+		return 1;
+	stats->dropped++;
+	return 0;
+}
+
+/* Lend the next queued RX packet to the UART, which sends it in place (less the header),
+ * and free it once the UART is done.  Pipes take turns a whole message at a time.
+ */
+void radio_rx_drain() {
+	PKT_QUEUE *q;
+	BUFFER *b;
+	uint8_t idle, hdr;
+
+	if (rx_lent) {
+		if (uart_tx_busy())
+			return;  // UART_TX_EVENT is posted when its last byte has gone
+		rx_lent = 0;
+		q = &rx_queue[rx_turn];
+		hdr = pkt_pool[q->head].buf[0];
+		pkt_release(pkt_pop(q));
+		if (hdr & MSG_LAST)  // Not in the middle of a message
+			rx_turn = (rx_turn + 1) % RX_PIPES;
+		if (msg_data)
+			msg_pump();  // A slot for the next fragment going out
+	}
+	for (idle = 0; idle < RX_PIPES; idle++) {
+		q = &rx_queue[rx_turn];
+		if (q->count) {
+			b = &pkt_pool[q->head];
+			if (uart_tx_packet(b->buf + 1, b->size - 1))
+				rx_lent = 1;
+			return;  // Either way UART_TX_EVENT brings us back
+		}
+		rx_turn = (rx_turn + 1) % RX_PIPES;
+	}
+}
+
+/* Handles the radio IRQ.  Received payloads are drained from the FIFO in one pass,
+ * straight into pool slots, until the FIFO or the pool runs dry.  With RF_TIMESTAMPS
+ * they all get the IRQ's stamp, which only the first one of a fresh RX_DR caused;
+ * the rest were already waiting behind it (or left over from a stall) and are marked
+ * late, their arrival is somewhere before the stamp.
+ */
+void recieve_bytes() {
+	uint8_t pipe, reason, i, stalled, batch = 0;
+#ifdef RF_TIMESTAMPS
+	uint32_t stamp = msprf24_irq_stamp();
+#endif
+
+	reason = msprf24_irq_take();
+	stalled = rx_stalled;
+	rx_stalled = 0;
+	if (radio_step == RADIO_PAUSED) {
+		flush_rx();  // The pool is on loan to the survey
+		return;
+	}
+	if ((reason & RF24_IRQ_RX) || stalled) {
+		while (1) {
+			if (!pkt_avail) {
+				if (!(msprf24_queue_state() & RF24_QUEUE_RXEMPTY)) {
+					pkt_exhausted++;
+					rx_stalled = 1;  // pkt_release() gets us going again
+				}
+				break;
+			}
+			i = pkt_alloc();
+			pkt_pool[i].size = msprf24_rx_next(pkt_pool[i].buf, &pipe);
+			if (!pkt_pool[i].size) {
+				pkt_release(i);
+				break;
+			}
+#ifdef RF_TIMESTAMPS
+			pkt_pool[i].stamp = stamp;
+			pkt_pool[i].late = batch || stalled || !(reason & RF24_IRQ_RX);
+#endif
+			if (!rx_deliver(pipe, i))
+				pkt_release(i);
+			batch++;
+		}
+		if (batch) {
+			connected = 1;
+			hop_idle = 0;
+			if (batch > rx_batch_max)
+				rx_batch_max = batch;
+		}
+		if (stream_rx())
+			ack_fill();
+	}
+#ifdef RF_TIMESTAMPS
+	if (!stream_rx() && (reason & (RF24_IRQ_TX | RF24_IRQ_TXFAILED))) {
+		// A stream's packets go back to back, each one's air time starts at the last one's end
+		tx_airtime += stamp - ((int32_t)(rf_tx_stamp - tx_stamp) > 0 ? rf_tx_stamp : tx_stamp);
+		tx_stamp = stamp;
+	}
+#endif
+	if (stream_rx()) {
+		// PRX TX_DS only means an ACK payload went out, already accounted for above
+#ifdef RF_BULK
+	} else if (bulk_state == BULK_DATA && (reason & RF24_IRQ_TX)) {
+		bulk_tx_done();
+#endif
+	} else if (reason & RF24_IRQ_TX) {
+		connected = 1;
+		retransmits = msprf24_get_last_retransmits();
+		link_tx_result(retransmits, 0);
+		tx_done();
+	} else if (reason & RF24_IRQ_TXFAILED) {
+		connected = 0;
+		flush_tx();  // MAX_RT leaves the payload in the TX FIFO
+		link_tx_result(15, 1);
+		msg_drop_orphans();
+		tx_done();
+	}
+}
+
+// Posted from the msprf24 Timer1_A ISR when a timed wait finishes
+static void radio_wakeup() {
+	sched_post_isr(RF_READY_EVENT);
+}
+
+void open_rx_stream() {
 	// Receive mode
 	if (!(RF24_QUEUE_RXEMPTY & msprf24_queue_state())) {
 		flush_rx();
@@ -89,12 +1177,162 @@ void open_rx_stream() {
 	msprf24_activate_rx();
 }
 
+// Opens pipe#0 (pipes 0-5 for a hub) and powers up; the 5ms oscillator start-up completes in radio_ready()
+void open_stream_pipes() {
+	uint8_t node[5];
+	uint8_t pipe;
+
+	msprf24_set_pipe_packetsize(0, 0);
+	msprf24_open_pipe(0, 1);  // Open pipe#0 with Enhanced ShockBurst
+	if (stream_mode == RX_MODE) {
+		msprf24_set_pipe_packetsize(LINK_CTRL_PIPE, 0);
+		msprf24_open_pipe(LINK_CTRL_PIPE, 1);  // Link control frames from the PTX
+#ifdef RF_BULK
+		link_bulk_addr(node);
+		w_rx_addr(BULK_PIPE, node);
+		msprf24_set_pipe_packetsize(BULK_PIPE, 0);
+		msprf24_open_pipe(BULK_PIPE, 1);  // NOACK bulk data, see bulk_send()
+#endif
+	} else if (stream_mode == RX_HUB_MODE) {
+		for (pipe = 0; pipe < 5; pipe++)
+			node[pipe] = addr[pipe];
+		for (pipe = 1; pipe < HUB_PIPES; pipe++) {
+			node[4] = pipe;
+			w_rx_addr(pipe, node);  // Pipes 2-5 only take the LSB, the rest comes from pipe 1
+			msprf24_set_pipe_packetsize(pipe, 0);
+			msprf24_open_pipe(pipe, 1);
+		}
+	}
+
+	radio_goto(RADIO_POWERUP_WAIT);
+	msprf24_standby_async(radio_wakeup);
+}
+
+/* Sensor side of RX_HUB_MODE: send to hub pipe node (1-5) instead of running a point to
+ * point link; call before open_stream().  The hub owns channel and rate, so hop and rate
+ * announcements are off, ARD/ARC tuning still runs.
+ */
+void radio_set_node(uint8_t node) {
+	hub_node = node;
+	addr[4] = node;
+	if (radio_step != RADIO_INIT_WAIT) {
+		w_tx_addr(addr);
+		w_rx_addr(0, addr);
+	}
+}
+
+// May be called before radio_init() has finished, the stream is opened once it has.
 void open_stream(RF_MODE mode) {
+#if !HUB_DEV
+	if (mode == RX_HUB_MODE)
+		return;  // Only HUB_DEV builds have the pipe tables for it
+#endif
+	stream_mode = mode;
+	stream_open = 1;
+	if (radio_step == RADIO_READY)
+		open_stream_pipes();
+}
+
+#ifdef TX_BENCHMARK
+// Print per-packet vs. streaming time for TX_BENCH_PACKETS x 32 bytes and MAX_RT stalls
+static void report_tx_bench() {
+	TX_BENCH_RESULT result;
+
+	tx_bench_run(&result);
+	LOG(LOG_TX_BENCH, LOG_U32(result.packet_us), result.packet_stalls,
+			LOG_U32(result.stream_us), result.stream_stalls);
+	LOG(LOG_NOACK, LOG_U32(result.noack_us));
+#ifdef RF_BULK
+	// Bulk goodput against the ESB numbers above, the first flash page onwards as data
+	bulk_send((const uint8_t *)BULK_BENCH_DATA, BULK_MAX_PACKETS * BULK_CHUNK);
+#endif
+}
+#endif
+
+#ifdef SPI_BENCHMARK
+/* Print SMCLK ticks per payload move: length, old write/read, block write/read.  Needs
+ * Timer1_A, so only between the init and power-up waits.
+ */
+static void report_spi_bench() {
+	SPI_BENCH_RESULT results[SPI_BENCH_SIZES];
+	uint8_t n;
+
+	spi_bench_run(results);
+	for (n = 0; n < SPI_BENCH_SIZES; n++) {
+		LOG(LOG_SPI_BENCH, results[n].len,
+				results[n].loop16_write, results[n].loop16_read,
+				results[n].block_write, results[n].block_read);
+	}
+}
+#endif
+
+#ifdef REG_BENCHMARK
+// Print SPI bytes per configuration call: row, read-modify-write / shadowed, see reg_bench.h
+static void report_reg_bench() {
+	REG_BENCH_RESULT results[REG_BENCH_CALLS];
+	uint8_t n, errors;
+
+	errors = reg_bench_run(results);
+	for (n = 0; n < REG_BENCH_CALLS; n++)
+		LOG(LOG_REG_BENCH, n, results[n].old_bytes, results[n].shadow_bytes);
+	LOG(LOG_REG_SHADOW, errors);
+}
+#endif
 
-	if (mode == TX_MODE)
-		open_tx_stream();
+// Advances radio bring-up, called from RF_READY_EVENT
+void radio_ready() {
+	uint8_t ctrl[5];
+
+	if (radio_step == RADIO_INIT_WAIT) {
+		msprf24_init_finish();
+#ifdef SPI_BENCHMARK
+		report_spi_bench();
+#endif
+#ifdef REG_BENCHMARK
+		report_reg_bench();
+#endif
+		w_tx_addr(addr);
+		w_rx_addr(0, addr); // Pipe 0 receives auto-ack's, autoacks are sent back to the TX addr so the PTX node
+		// needs to listen to the TX addr on pipe#0 to receive them.
+		link_ctrl_addr(ctrl);
+		w_rx_addr(LINK_CTRL_PIPE, ctrl);
+		msprf24_enable_feature(RF24_EN_ACK_PAY);  // Downlink data rides on the ACKs, see radio_send()
+		rf_ack_payload_len = ACK_PAYLOAD_MAX;
+		link_tune_retransmit();
+		radio_goto(RADIO_READY);
+		if (stream_open)
+			open_stream_pipes();
+	} else if (radio_step == RADIO_POWERUP_WAIT) {
+		radio_goto(RADIO_READY);
+		if (stream_rx())
+			open_rx_stream();
+#ifdef TX_BENCHMARK
+		else
+			report_tx_bench();
+#endif
+	}
+}
+
+/* Hand the radio to something else (e.g. a survey) along with the packet pool as
+ * PKT_POOL_SIZE * sizeof(BUFFER) bytes of scratch; returns 0 if the radio isn't up yet
+ * or packets are still waiting.
+ */
+uint8_t *radio_pause() {
+	if (radio_step != RADIO_READY || pkt_avail < PKT_POOL_SIZE || msg_data)
+		return 0;
+	radio_goto(RADIO_PAUSED);
+	return (uint8_t *)pkt_pool;
+}
+
+// Back on the link channel, reopening the stream if one was open
+void radio_resume() {
+	pkt_init();  // Scratch contents are garbage to the free list
+	msprf24_set_channel();
+	radio_goto(RADIO_READY);
+	if (stream_open)
+		open_stream_pipes();
 	else
-		open_rx_stream();
+		msprf24_standby();
 }
 
 void radio_init() {
@@ -103,19 +1341,21 @@ void radio_init() {
 	/* Initial values for nRF24L01+ library config variables */
 	rf_crc = RF24_EN_CRC | RF24_CRCO; // CRC enabled, 16-bit
 	rf_addr_width = 5;
-	rf_speed_power = RF24_SPEED_2MBPS | RF24_POWER_0DBM;
-	rf_channel = 120;
+	rf_speed_power = rate_table[RATE_DEFAULT];
+	rf_channel = hop_table[0];
 
 // Set our RX address
 	addr[0] = 0xDE;
 	addr[1] = 0xAD;
 	addr[2] = 0xBE;
 	addr[3] = 0xEF;
-	addr[4] = 0x00;
+	addr[4] = hub_node;
 
-	msprf24_init();
-	w_tx_addr(addr);
-	w_rx_addr(0, addr); // Pipe 0 receives auto-ack's, autoacks are sent back to the TX addr so the PTX node
-// needs to listen to the TX addr on pipe#0 to receive them.
+	pkt_init();
+	radio_goto(RADIO_INIT_WAIT);
+#ifdef RF_TIMESTAMPS
+	sched_hold(SCHED_SMCLK_RADIO);  // The timestamp clock
+#endif
+	msprf24_init_async(radio_wakeup);
 }
 
@@ -9,10 +9,12 @@
 #define NRF24API_H_
 
 #include "stdint.h"
+#include "nrf_userconfig.h"
+#include "interrupts.h"
 
 // enums, typedefs
 typedef enum {
-	TX_MODE, RX_MODE
+	TX_MODE, RX_MODE, TX_STREAM_MODE, RX_HUB_MODE
 } RF_MODE;
 
 typedef enum {
@@ -20,19 +22,153 @@ typedef enum {
 } NRF_STATE;
 
 typedef struct {
+#ifdef RF_TIMESTAMPS
+	uint32_t stamp;		// received: msprf24_irq_stamp() of the IRQ that brought it
+	uint8_t late;		// stamp is only an upper bound, see recieve_bytes()
+#endif
 	uint8_t size;
 	uint8_t buf[32];
 } BUFFER;
 
+// Per-pipe receive counters (pipe 0 only unless RX_HUB_MODE), all wrap
+typedef struct {
+	uint16_t packets;
+	uint16_t dropped;	// no room in the packet pool, over HUB_PIPE_SLOTS or part of a broken message
+	uint16_t bytes;
+} PIPE_STATS;
+
+/* Packet pool shared by the send and receive queues, 33 bytes a slot (38 with
+ * RF_TIMESTAMPS); a survey borrows it as scratch for its 63 bytes (radio_pause()) and the
+ * serial bridge fills its payloads in place (radio_stream_buf()).  Messages pass through
+ * it a fragment at a time, so their size doesn't depend on it: a 200 byte record is 7
+ * fragments from the PTX, one in the pool at a time while the other slot is kept free
+ * for receiving.  Payloads that find the pool full wait in the chip's RX FIFO.
+ *
+ * RAM budget, G2553 (512 bytes).  Static data (.bss, .data, .noinit) is 416 bytes in the
+ * default PTX build, 70 of them this pool and its links and 43 the trace (TRACE_ENABLE),
+ * which leaves 96 for the stack.  The deepest stack is spi_tx_event() down to
+ * spi_transfer16() through msg_send() and msprf24_stream_tx(), with the UART RX interrupt
+ * and its trace call on top: about 90 bytes counted by hand.  A PRX is 387 (no bridge),
+ * a hub 447 (six pipes of queues and counters, 65 left), with a shallower stack as
+ * neither runs msprf24_stream_tx().  Options cost: RF_BULK 71, each pool slot 35.  What
+ * is turned on has to come off somewhere else first.
+ */
+#define PKT_POOL_SIZE		2
+#define PKT_NONE			0xFF
+#define TX_FIFO_DEPTH		3
+
+/* RX_HUB_MODE: one PRX serving up to six PTX nodes.  Pipe 0 listens on addr, pipes 1-5
+ * on addr with the LSB replaced by the pipe number; a sensor node sets that LSB with
+ * radio_set_node().  The hub stays on its channel and rate, link control is off.
+ */
+#define HUB_PIPES			6
+#define HUB_PIPE_SLOTS		1		// pool slots one hub pipe may hold, so a chatty node can't take them all
+
+// Pipes with receive queues and counters: six on a hub (HUB_DEV), else the data pipe and bulk
+#if HUB_DEV
+#define RX_PIPES			HUB_PIPES
+#elif defined(RF_BULK)
+#define RX_PIPES			(BULK_PIPE + 1)
+#else
+#define RX_PIPES			1
+#endif
+
+/* PRX -> PTX data rides on ACK payloads (radio_send()).  15 bytes is the most that
+ * still fits a 250uS ARD at 2Mbps; msprf24_min_retransmit_delay() covers the rest.
+ */
+#define ACK_PAYLOAD_MAX		15
+
+/* All data (radio_send()) travels as messages of one or more fragments { header, data }.
+ * Neither end holds a whole one: the sender copies fragments out of the caller's buffer
+ * as pool slots free up, the receiver queues each in-order fragment for the UART as it
+ * comes.  A fragment that doesn't follow on means one was lost; what is still queued of
+ * that message is dropped and the rest of it refused, what the UART has sent already is
+ * gone.  The id tells a fresh message from the tail of one that lost fragments.
+ */
+#define MSG_LAST			0x80	// header: last fragment of the message
+#define MSG_ID				0x70	// header: message id, counts up by MSG_ID_STEP
+#define MSG_ID_STEP			0x10
+#define MSG_COBS			0x08	// header: serial bridge stream, COBS decoded on the way out (bridge.h)
+#define MSG_INDEX			0x07	// header: fragment number, mod 8
+#define MSG_CHUNK			31		// data bytes per fragment, PTX -> PRX
+#define MSG_MAX				255		// bytes, 9 fragments PTX -> PRX or 19 ACK payloads back
+
+// Link control frames (hop commands etc.) go to pipe 1 at addr with the LSB inverted
+#define LINK_CTRL_PIPE		1
+#define LINK_CMD_NONE		0x00
+#define LINK_CMD_HOP		0x01	// { LINK_CMD_HOP, hop index }
+#define LINK_CMD_RATE		0x02	// { LINK_CMD_RATE, rate level }
+#define LINK_CMD_BULK		0x03	// { LINK_CMD_BULK, packet count } starts a bulk transfer
+#define LINK_CMD_BULK_POLL	0x04	// { LINK_CMD_BULK_POLL, round }, the ACK payload is the NACK report
+
+/* NOACK bulk transfer (RF_BULK, bulk_send()): { seq, up to BULK_CHUNK bytes } to pipe 2,
+ * no ACKs.  After each round the PTX polls and the PRX answers in the poll's ACK payload
+ * with { round, count | BULK_MORE, missing seq... }; only those are sent again.
+ */
+#define BULK_PIPE			2
+#define BULK_CHUNK			31
+#define BULK_MAX_PACKETS	128		// PRX keeps one bit per packet
+#define BULK_HOLD			2		// out-of-order packets the PRX holds while waiting for a gap
+#define BULK_MORE			0x80	// more missing than fit in one report
+#define BULK_TRIES			16		// failed starts/polls in a row before the PTX gives up
+#define BULK_BENCH_DATA		0xC000	// TX_BENCHMARK: start of G2553 flash
+
+// Adaptive frequency hopping
+#define HOP_CHANNELS		8
+#define HOP_BAD_SCORE		128		// ~4 retransmits/packet on average
+#define HOP_GOOD_SCORE		32		// blacklisted channel is usable again below this
+#define HOP_FAIL_PENALTY	64		// score input for a MAX_RT, retransmits count 4 each
+#define HOP_FAIL_LIMIT		4		// consecutive MAX_RT before the PTX considers itself lost
+#define HOP_RESYNC_PINGS	3		// PRX ping periods without traffic before it starts searching
+
+// Data rate / TX power adaptation, levels ordered from cheapest to most robust
+#define RATE_LEVELS			6
+#define RATE_DEFAULT		3		// 2Mbps, 0dBm
+#define RATE_FALLBACK		(RATE_LEVELS - 1)	// both ends drop here when the link is lost
+#define RATE_WINDOW			32		// packets per evaluation
+#define RATE_UP_ARC			(3 * RATE_WINDOW)	// retransmits per window that call for a more robust level
+#define RATE_UP_FAILS		2		// MAX_RT per window that call for a more robust level
+#define RATE_DOWN_ARC		(RATE_WINDOW / 2)	// retransmits per window that count as calm
+#define RATE_DOWN_WINDOWS	4		// consecutive calm windows before trying a cheaper level
+
+// Auto-retransmit tuning, re-run every rate window and whenever speed/power changes
+#define ARD_STEP			250		// uS per SETUP_RETR ARD step
+#define ARD_MAX_MARGIN		4		// ARD steps added on top of the minimum for bursty loss
+#define ARC_MIN				3
+#define ARC_MAX				15
+
 //function prototypes
 void radio_init();
 void open_stream(RF_MODE mode);
+void radio_set_node(uint8_t node);
+void radio_rx_drain();
+#ifdef SPI_ASYNC
+void radio_tx_written();
+#endif
+uint8_t radio_send(uint8_t pipe, const uint8_t *data, uint16_t len);
+uint8_t radio_send_busy();
+uint8_t *radio_stream_buf();
+void radio_stream_send(uint8_t len);
+#ifdef RF_BULK
+uint8_t bulk_send(const uint8_t *data, uint16_t len);
+uint8_t bulk_busy();
+#endif
+void radio_ready();
+uint8_t *radio_pause();
+void radio_resume();
+void link_tick();
 void recieve_bytes();
-void transmit_bytes();
+void transmit_bytes(const char *data, uint8_t len);
 void reset_connected();
 uint8_t is_connected();
 
 //variables
-extern volatile BUFFER buffer;
+extern PIPE_STATS pipe_stats[RX_PIPES];
+extern uint16_t pkt_exhausted;
+extern uint8_t pkt_high_water;
+#ifdef RF_TIMESTAMPS
+extern uint32_t tx_stamp;
+extern uint32_t tx_airtime;
+#endif
 
 #endif /* NRF24API_H_ */
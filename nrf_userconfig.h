@@ -46,6 +46,22 @@
 #define DELAY_CYCLES_15US      360
  */
 
+/* ACLK ticks for the waits msprf24_init_async()/msprf24_standby_async() time with
+ * Timer1_A.  ACLK is expected to be the VLO (4-20KHz on G2xx parts); counts assume
+ * the 20KHz worst case so the delays are never short.
+ */
+#define DELAY_ACLK_5MS         100
+#define DELAY_ACLK_100MS       2000
+
+/* Uncomment to timestamp the IRQ line in hardware: P2.2 goes to Timer1_A CCI1B and
+ * Timer1_A runs continuously from SMCLK (125ns), so the waits above are timed from
+ * SMCLK too, RF24_SMCLK_PER_ACLK per ACLK tick.  Keeps SMCLK running (LPM1 at best) and
+ * leaves no Timer1_A for TX_BENCHMARK/SPI_BENCHMARK.
+#define RF_TIMESTAMPS 1
+ */
+#define RF24_STAMP_HZ          8000000UL
+#define RF24_SMCLK_PER_ACLK    (RF24_STAMP_HZ / 20000)
+
 /* SPI port--Select which USCI port we're using.
  * Applies only to USCI devices.  USI users can keep these
  * commented out.
@@ -53,6 +69,77 @@
 //#define SPI_DRIVER_USCI_A 1
 #define SPI_DRIVER_USCI_B 1
 
+/* Uncomment for interrupt-driven SPI transactions (msp430_spi.c spi_async_*,
+ * w_tx_payload_async()/r_rx_payload_async()), USCI_B on G2xx3 only.  The USCIAB0RX
+ * vector is shared with the UART, see uart.c.  The PTX then writes its queued packets
+ * to the TX FIFO this way (RF_WRITTEN_EVENT); received payloads are still read
+ * synchronously, the FIFO drain needs the width and pipe between them.  Only worth it
+ * with a slow SPI clock: at SMCLK a byte takes 16 MCLK cycles, less than an interrupt
+ * costs, so the CPU would never get to sleep in a transfer.
+#define SPI_ASYNC 1
+ */
+
+/* Uncomment to report spi_transfer16() vs. block payload transfer timings at startup.
+#define SPI_BENCHMARK 1
+ */
+
+/* Uncomment to report SPI bytes per msprf24 configuration call at startup, reading the
+ * register back first (as before the shadow) against the shadowed setters, see reg_bench.h.
+#define REG_BENCHMARK 1
+ */
+
+/* Uncomment to time per-packet activate_tx() against msprf24_stream_tx() once the PTX
+ * link is up (needs the PRX listening).
+#define TX_BENCHMARK 1
+ */
+
+/* Uncomment for NOACK bulk transfers, bulk_send() on the PTX and pipe 2 on the PRX.  Its
+ * state and pipe 2's queue and counters take 71 bytes of RAM, see PKT_POOL_SIZE in
+ * nrf24api.h; TX_BENCHMARK then also reports bulk goodput.
+#define RF_BULK 1
+ */
+
+/* Uncomment for a serial bridge report every BRIDGE_REPORT_SECS seconds on the PTX: bytes,
+ * payloads and the latency coalescing added, see bridge_set_idle().
+#define BRIDGE_REPORTS 1
+ */
+
+/* Uncomment to count scheduler dispatches and their cost in sched_stats; runs Timer0_A
+ * from SMCLK, so not together with find_baud_rate() or TICKLESS.
+#define SCHED_PROFILE 1
+ */
+
+/* Uncomment to keep time with Timer0_A from ACLK instead of the 0.5ms WDT interval:
+ * the CPU is only woken for the next timer deadline and can sleep in LPM3 when the
+ * UART allows it (UART_SLEEPS).  Timers then run in ACLK ticks, as exact as the VLO
+ * (4-20KHz) is, ACLK_HZ being its nominal rate.  Takes find_baud_rate()'s timer.
+#define TICKLESS 1
+ */
+#define ACLK_HZ 12000
+
+/* Uncomment to let SMCLK stop while the UART has nothing to send, so TICKLESS can get
+ * to LPM3.  The USCI can't receive without SMCLK: only for nodes whose UART is output.
+#define UART_SLEEPS 1
+ */
+
+/* Uncomment for wakeups per second and an estimated MCU current every
+ * POWER_REPORT_SECS seconds, to compare TICKLESS against the WDT tick.
+#define POWER_REPORTS 1
+ */
+
+/* Uncomment to time the driver and event hot paths in MCLK cycles, see prof.h.  Runs
+ * Timer0_A from SMCLK like SCHED_PROFILE (which then shares it), so not together with
+ * find_baud_rate() or TICKLESS.
+#define PROFILE 1
+ */
+
+/* Records scheduler dispatches, ISR entries and radio state changes in a ring that
+ * survives a soft reset, dumped on request, see trace.h.  Meant to stay on in production
+ * builds: a short call per event and 43 bytes of RAM, budgeted at PKT_POOL_SIZE in
+ * nrf24api.h.  Comment out to get them back.
+ */
+#define TRACE_ENABLE 1
+
 
 /* Operational pins -- IRQ, CE, CSN (SPI chip-select)
  */
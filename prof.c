@@ -0,0 +1,70 @@
+/*
+ * prof.c
+ *
+ * Cycle profiler, see prof.h.
+ */
+
+#include <msp430.h>
+#include "nrf_userconfig.h"
+
+#ifdef PROFILE
+
+#include "prof.h"
+#include "log.h"
+#include "uart.h"
+
+#ifdef TICKLESS
+#error "PROFILE and TICKLESS both want Timer0_A"
+#endif
+
+#define DUMP_IDLE	(PROF_PROBES + 1)	// dump_next: 0 is the header, then one per probe
+
+PROF_ENTRY prof_table[PROF_PROBES];
+uint16_t prof_start[PROF_PROBES];
+uint16_t prof_overhead;
+static uint8_t dump_next = DUMP_IDLE;
+
+// Start the clock (SCHED_PROFILE reads it too) and measure what a probe costs itself
+void prof_init() {
+	TA0CTL = TASSEL_2 | MC_2 | TACLR;  // SMCLK, continuous
+	PROF_BEGIN(PROF_R_REG);
+	prof_overhead = TA0R - prof_start[PROF_R_REG];
+}
+
+void prof_record(uint8_t id, uint16_t ticks) {
+	PROF_ENTRY *p = &prof_table[id];
+
+	if (!p->count || ticks < p->min)
+		p->min = ticks;
+	if (ticks > p->max)
+		p->max = ticks;
+	p->count++;
+	p->total += ticks;
+}
+
+// Queue the table for the UART; it goes out a record at a time from prof_dump_poll()
+void prof_dump() {
+	dump_next = 0;
+	prof_dump_poll();
+}
+
+// From UART_TX_EVENT: as many records as the TX ring has room for
+void prof_dump_poll() {
+	PROF_ENTRY e;
+	uint16_t state;
+
+	while (dump_next != DUMP_IDLE && uart_tx_room() >= LOG_RECORD_MAX) {
+		if (!dump_next) {
+			LOG(LOG_PROF_HEAD, PROF_PROBES, PROF_MCLK_PER_TICK, prof_overhead);
+		} else {
+			state = __get_interrupt_state();
+			__disable_interrupt();
+			e = prof_table[dump_next - 1];  // ISR probes keep counting meanwhile
+			__set_interrupt_state(state);
+			LOG(LOG_PROF, dump_next - 1, LOG_U32(e.count), e.min, e.max, LOG_U32(e.total));
+		}
+		dump_next++;
+	}
+}
+
+#endif
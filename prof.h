@@ -0,0 +1,62 @@
+/*
+ * prof.h
+ *
+ * Cycle profiler (PROFILE in nrf_userconfig.h).  PROF_BEGIN(id) and PROF_END(id)
+ * bracket a hot path; each pair adds one call to the probe's count, min, max and
+ * total in prof_table.  The clock is Timer0_A running free from SMCLK, MCLK / 2,
+ * so a tick is PROF_MCLK_PER_TICK cycles and one call can be timed up to 8ms.
+ * Without PROFILE the probes are empty and nothing here is built.
+ *
+ * The host sends { 0, 0, UART_PROF_REQ } to have the table sent back as LOG_PROF_HEAD
+ * and LOG_PROF records, see uart.h; tools/profdump.py sends it and prints the table
+ * with the names below.  Append new probes at the end, like log_ids.h.
+ *
+ * Each id must only be in flight once: a probe isn't reentrant, an ISR needs its own.
+ */
+
+#ifndef PROF_H_
+#define PROF_H_
+
+#include <stdint.h>
+#include "nrf_userconfig.h"
+
+#define PROF_PROBES_TABLE \
+	X(PROF_R_REG,			"r_reg") \
+	X(PROF_W_TX_PAYLOAD,	"w_tx_payload") \
+	X(PROF_RECIEVE_BYTES,	"recieve_bytes") \
+	X(PROF_UART_TX_EVENT,	"uart_tx_event") \
+	X(PROF_WDT_ISR,			"WDT_ISR")
+
+#define X(id, name)	id,
+typedef enum { PROF_PROBES_TABLE PROF_PROBES } PROF_ID;
+#undef X
+
+#define PROF_MCLK_PER_TICK	2	// MCLK 16MHz, SMCLK 8MHz
+
+#ifdef PROFILE
+#include <msp430.h>
+
+typedef struct {
+	uint32_t count;
+	uint32_t total;			// ticks
+	uint16_t min;
+	uint16_t max;
+} PROF_ENTRY;
+
+extern PROF_ENTRY prof_table[PROF_PROBES];
+extern uint16_t prof_start[PROF_PROBES];
+extern uint16_t prof_overhead;		// ticks an empty PROF_BEGIN/PROF_END pair reads
+
+#define PROF_BEGIN(id)	(prof_start[id] = TA0R)
+#define PROF_END(id)	prof_record(id, TA0R - prof_start[id])
+
+void prof_init();
+void prof_record(uint8_t id, uint16_t ticks);
+void prof_dump();
+void prof_dump_poll();
+#else
+#define PROF_BEGIN(id)
+#define PROF_END(id)
+#endif
+
+#endif /* PROF_H_ */
@@ -0,0 +1,98 @@
+/*
+ * reg_bench.c
+ *
+ * Counts the SPI bytes (spi_bytes, msp430_spi.c) each configuration call takes.  The
+ * read-modify-write versions below are the setters as they were before the register
+ * shadow.  Both write the same values, so the chip ends up where the shadow says; the
+ * configuration is reset afterwards.  Run it between msprf24_init_finish() and the
+ * first pipe being opened.
+ */
+
+#include <msp430.h>
+#include "nrf_userconfig.h"
+
+#ifdef REG_BENCHMARK
+
+#include "reg_bench.h"
+#include "msp430_spi.h"
+#include "msprf24.h"
+#include "nRF24L01.h"
+
+#define BENCH_PIPE	3
+
+static void old_open_pipe(uint8_t pipeid, uint8_t autoack) {
+	uint8_t rxen, enaa;
+
+	rxen = r_reg(RF24_EN_RXADDR);
+	enaa = r_reg(RF24_EN_AA);
+	if (autoack)
+		enaa |= (1 << pipeid);
+	else
+		enaa &= ~(1 << pipeid);
+	rxen |= (1 << pipeid);
+	w_reg(RF24_EN_RXADDR, rxen);
+	w_reg(RF24_EN_AA, enaa);
+}
+
+static void old_close_pipe(uint8_t pipeid) {
+	uint8_t rxen, enaa;
+
+	rxen = r_reg(RF24_EN_RXADDR);
+	enaa = r_reg(RF24_EN_AA);
+	rxen &= ~(1 << pipeid);
+	enaa &= ~(1 << pipeid);
+	w_reg(RF24_EN_RXADDR, rxen);
+	w_reg(RF24_EN_AA, enaa);
+}
+
+// Dynamic payload length only, which is what nrf24api asks for
+static void old_set_pipe_packetsize(uint8_t pipe) {
+	w_reg(RF24_DYNPD, r_reg(RF24_DYNPD) | (1 << pipe));
+}
+
+static void old_set_retransmit_delay(uint16_t us) {
+	uint8_t c;
+
+	if (us < msprf24_min_retransmit_delay())
+		us = msprf24_min_retransmit_delay();
+	c = r_reg(RF24_SETUP_RETR) & 0x0F;
+	w_reg(RF24_SETUP_RETR, c | ((((us - 250) / 250) << 4) & 0xF0));
+}
+
+static void old_set_retransmit_count(uint8_t count) {
+	w_reg(RF24_SETUP_RETR, (r_reg(RF24_SETUP_RETR) & 0xF0) | (count & 0x0F));
+}
+
+static void old_set_config(uint8_t cfgval) {
+	(void)r_reg(RF24_CONFIG);  // The old setter returned the previous value
+	w_reg(RF24_CONFIG, ((rf_crc & 0x0C) | cfgval) & ~(RF24_MASK_RX_DR | RF24_MASK_TX_DS | RF24_MASK_MAX_RT));
+}
+
+#define BENCH(row, old, shadow) do { \
+		spi_bytes = 0; \
+		old; \
+		results[row].old_bytes = spi_bytes; \
+		spi_bytes = 0; \
+		shadow; \
+		results[row].shadow_bytes = spi_bytes; \
+	} while (0)
+
+/* Fill in REG_BENCH_CALLS results; returns how many shadowed registers disagree with
+ * the chip afterwards (msprf24_verify_shadow(), 0 is right).
+ */
+uint8_t reg_bench_run(REG_BENCH_RESULT *results) {
+	uint8_t errors;
+
+	BENCH(REG_BENCH_OPEN_PIPE, old_open_pipe(BENCH_PIPE, 1), msprf24_open_pipe(BENCH_PIPE, 1));
+	BENCH(REG_BENCH_CLOSE_PIPE, old_close_pipe(BENCH_PIPE), msprf24_close_pipe(BENCH_PIPE));
+	BENCH(REG_BENCH_PACKETSIZE, old_set_pipe_packetsize(BENCH_PIPE), msprf24_set_pipe_packetsize(BENCH_PIPE, 0));
+	BENCH(REG_BENCH_RETR_DELAY, old_set_retransmit_delay(0), msprf24_set_retransmit_delay(0));
+	BENCH(REG_BENCH_RETR_COUNT, old_set_retransmit_count(10), msprf24_set_retransmit_count(10));
+	BENCH(REG_BENCH_SET_CONFIG, old_set_config(0), msprf24_set_config(0));
+	BENCH(REG_BENCH_STATE, msprf24_current_state(), msprf24_cached_state());
+	errors = msprf24_verify_shadow();
+	msprf24_init_finish();  // Back to the configuration the rest of the startup expects
+	return errors;
+}
+
+#endif
@@ -0,0 +1,31 @@
+/*
+ * reg_bench.h
+ *
+ * SPI bytes per msprf24 configuration call, read-modify-write through the chip
+ * (as before the register shadow) against the shadowed setters.  Build with
+ * REG_BENCHMARK defined in nrf_userconfig.h.
+ */
+
+#ifndef REG_BENCH_H_
+#define REG_BENCH_H_
+
+#include <stdint.h>
+
+// One row per call measured
+#define REG_BENCH_OPEN_PIPE		0
+#define REG_BENCH_CLOSE_PIPE	1
+#define REG_BENCH_PACKETSIZE	2
+#define REG_BENCH_RETR_DELAY	3
+#define REG_BENCH_RETR_COUNT	4
+#define REG_BENCH_SET_CONFIG	5
+#define REG_BENCH_STATE			6	// msprf24_current_state() vs. msprf24_cached_state()
+#define REG_BENCH_CALLS			7
+
+typedef struct {
+	uint16_t old_bytes;		// SPI bytes, reading the register back first
+	uint16_t shadow_bytes;	// SPI bytes, current msprf24.c
+} REG_BENCH_RESULT;
+
+uint8_t reg_bench_run(REG_BENCH_RESULT *results);
+
+#endif /* REG_BENCH_H_ */
@@ -0,0 +1,81 @@
+/*
+ * ring.c
+ *
+ * See ring.h for the concurrency rules.  Bulk calls move at most two memcpy()s, one
+ * up to the end of the storage and one from its start.
+ */
+
+#include "ring.h"
+#include <string.h>
+
+uint8_t ring_count(const RING *r) {
+	return (uint8_t)(r->head - r->tail);
+}
+
+uint8_t ring_room(const RING *r) {
+	return r->mask + 1 - ring_count(r);
+}
+
+// After head has moved: track the fill level for tuning
+static void ring_track(RING *r) {
+	uint8_t n = ring_count(r);
+
+	if (n > r->high_water)
+		r->high_water = n;
+}
+
+// Returns 0 if the ring is full; the byte is dropped and counted
+uint8_t ring_put(RING *r, uint8_t c) {
+	if (!ring_room(r)) {
+		r->overflows++;
+		return 0;
+	}
+	r->buf[r->head & r->mask] = c;
+	r->head++;
+	ring_track(r);
+	return 1;
+}
+
+// Queue up to len bytes in one go, returns how many fit; the rest count as overflow
+uint8_t ring_write(RING *r, const uint8_t *data, uint8_t len) {
+	uint8_t room = ring_room(r), at, first;
+
+	if (len > room) {
+		r->overflows += len - room;
+		len = room;
+	}
+	at = r->head & r->mask;
+	first = r->mask + 1 - at;
+	if (first > len)
+		first = len;
+	memcpy(r->buf + at, data, first);
+	memcpy(r->buf, data + first, len - first);
+	r->head += len;
+	ring_track(r);
+	return len;
+}
+
+// Returns 0 if the ring is empty
+uint8_t ring_get(RING *r, uint8_t *c) {
+	if (r->head == r->tail)
+		return 0;
+	*c = r->buf[r->tail & r->mask];
+	r->tail++;
+	return 1;
+}
+
+// Take up to len bytes in one go, returns how many there were
+uint8_t ring_read(RING *r, uint8_t *data, uint8_t len) {
+	uint8_t n = ring_count(r), at, first;
+
+	if (len > n)
+		len = n;
+	at = r->tail & r->mask;
+	first = r->mask + 1 - at;
+	if (first > len)
+		first = len;
+	memcpy(data, r->buf + at, first);
+	memcpy(data + first, r->buf, len - first);
+	r->tail += len;
+	return len;
+}
@@ -0,0 +1,39 @@
+/*
+ * ring.h
+ *
+ * Single-producer/single-consumer byte rings for the UART.  One side runs in an ISR,
+ * the other in the main loop, and neither ever disables interrupts: the producer
+ * only writes head and the consumer only writes tail, each after the data it covers
+ * is in place, and both are single byte stores.  Indices run free and are masked on
+ * access, so the size must be a power of two, 128 at most.
+ */
+
+#ifndef RING_H_
+#define RING_H_
+
+#include <stdint.h>
+
+typedef struct {
+	uint8_t *buf;
+	uint8_t mask;				// size - 1
+	volatile uint8_t head;		// producer's
+	volatile uint8_t tail;		// consumer's
+	uint8_t high_water;			// most bytes ever waiting (producer's)
+	uint16_t overflows;			// bytes refused because the ring was full (producer's)
+} RING;
+
+// Static initializer over an array whose size is a power of two
+#define RING_INIT(storage)	{ storage, sizeof(storage) - 1, 0, 0, 0, 0 }
+
+uint8_t ring_count(const RING *r);
+uint8_t ring_room(const RING *r);
+
+// Producer side
+uint8_t ring_put(RING *r, uint8_t c);
+uint8_t ring_write(RING *r, const uint8_t *data, uint8_t len);
+
+// Consumer side
+uint8_t ring_get(RING *r, uint8_t *c);
+uint8_t ring_read(RING *r, uint8_t *data, uint8_t len);
+
+#endif /* RING_H_ */
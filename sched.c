@@ -0,0 +1,155 @@
+/*
+ * sched.c
+ *
+ * Priority event dispatch and sleep, see sched.h.
+ */
+
+#include <msp430.h>
+#include "sched.h"
+#include "events.h"
+#include "msprf24.h"
+#include "msp430_spi.h"
+#include "interrupts.h"
+#include "nrf_userconfig.h"
+#include "trace.h"
+
+#if SCHED_EVENTS > 16
+#error "sys_event has 16 bits"
+#endif
+
+#define SCHED_NONE	0xFF
+
+volatile uint16_t sys_event = 0;
+volatile uint8_t sched_pending[SCHED_EVENTS];
+volatile uint8_t sched_keep = 0;
+uint16_t sched_sleeps = 0;
+#ifdef POWER_REPORTS
+uint32_t sched_asleep = 0;
+#endif
+
+#ifdef SCHED_PROFILE
+SCHED_STATS sched_stats;
+#endif
+
+void sched_post(uint8_t ev) {
+	uint16_t state = __get_interrupt_state();
+
+	__disable_interrupt();
+	sched_post_isr(ev);
+	__set_interrupt_state(state);
+}
+
+void sched_hold(uint8_t keep) {
+	uint16_t state = __get_interrupt_state();
+
+	__disable_interrupt();
+	sched_keep |= keep;
+	__set_interrupt_state(state);
+}
+
+void sched_release(uint8_t keep) {
+	uint16_t state = __get_interrupt_state();
+
+	__disable_interrupt();
+	sched_keep &= ~keep;
+	__set_interrupt_state(state);
+}
+
+// Anything to run?  Interrupts off
+static uint16_t sched_ready() {
+	uint16_t ready = sys_event;
+
+	if (rf_irq & RF24_IRQ_FLAGGED)
+		ready |= 1u << SPI_RX_EVENT;
+	return ready;
+}
+
+// Highest pending event with its post taken, SCHED_NONE if idle.  Interrupts off
+static uint8_t sched_take() {
+	uint16_t ready = sched_ready();
+	uint8_t ev = 0;
+
+	if (!ready)
+		return SCHED_NONE;
+	while (!(ready & 1)) {
+		ready >>= 1;
+		ev++;
+	}
+	if (sched_pending[ev]) {  // zero for a radio IRQ nobody posted
+		if (sched_events[ev].flags & SCHED_DRAIN)
+			sched_pending[ev] = 0;
+		else
+			sched_pending[ev]--;
+		if (!sched_pending[ev])
+			sys_event &= ~(1u << ev);
+	}
+	return ev;
+}
+
+// Runs handlers until nothing is pending, returns how many ran
+uint16_t sched_run_until_idle() {
+	uint16_t runs = 0;
+	uint8_t ev;
+#ifdef SCHED_PROFILE
+	uint16_t start, cost;
+#endif
+
+	while (1) {
+#ifdef SCHED_PROFILE
+		start = TA0R;
+#endif
+		_disable_interrupts();
+		ev = sched_take();
+		_enable_interrupts();
+		if (ev == SCHED_NONE)
+			return runs;
+		TRACE(TRACE_DISPATCH, ev);
+#ifdef SCHED_PROFILE
+		cost = TA0R - start;
+		sched_stats.runs++;
+		sched_stats.cost_total += cost;
+		if (cost > sched_stats.cost_max)
+			sched_stats.cost_max = cost;
+#endif
+		sched_events[ev].handler();
+		runs++;
+	}
+}
+
+/* Sleep as deep as sched_keep allows until an ISR wakes us.  Called with interrupts
+ * off, returns with them on; an async SPI transfer in flight needs SMCLK as well.
+ */
+void sched_sleep() {
+#ifdef POWER_REPORTS
+	uint16_t start = clock_ticks();
+#endif
+
+	sched_sleeps++;
+	if (sched_keep || !spi_async_idle()) {
+		TRACE_ISR(TRACE_SLEEP, 1);
+		__bis_SR_register(LPM1_bits | GIE);
+	} else {
+		TRACE_ISR(TRACE_SLEEP, 3);
+		__bis_SR_register(LPM3_bits | GIE);
+	}
+#ifdef POWER_REPORTS
+	sched_asleep += (uint16_t)(clock_ticks() - start);
+#endif
+}
+
+/* The main loop: run, then sleep until an ISR posts and wakes us.  The last check
+ * and the sleep are one step with interrupts off, so a post can't slip in between.
+ */
+void sched_run() {
+#if defined(SCHED_PROFILE) && !defined(PROFILE)
+	TA0CTL = TASSEL_2 | MC_2 | TACLR;  // SMCLK, continuous: the dispatch clock
+#endif
+	while (1) {
+		sched_run_until_idle();
+		_disable_interrupts();
+		if (sched_ready())
+			_enable_interrupt();
+		else
+			sched_sleep();
+	}
+}
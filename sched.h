@@ -0,0 +1,69 @@
+/*
+ * sched.h
+ *
+ * Event scheduler.  Events are numbered by priority, 0 first; events.c holds the
+ * table of their handlers, so a new event is an id in events.h plus an entry there.
+ * Each post is counted, and a handler runs once per post unless its entry is marked
+ * SCHED_DRAIN, meaning one run deals with everything queued (a ring, a FIFO).
+ * After every handler the highest pending event goes next.
+ *
+ * ISRs post with sched_post_isr() (interrupts are already off there) and wake the
+ * CPU themselves; the main loop uses sched_post().  The radio's IRQ needs no post:
+ * RF24_IRQ_FLAGGED in rf_irq keeps SPI_RX_EVENT pending until recieve_bytes() has
+ * dealt with it.
+ */
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include <stdint.h>
+
+#define SCHED_DRAIN		0x01	// one run takes all pending posts
+
+// sched_keep: who needs SMCLK through sleep (LPM1); nobody means LPM3
+#define SCHED_SMCLK_TICK	0x01	// the WDT interval timer
+#define SCHED_SMCLK_UART	0x02	// BRCLK, see UART_SLEEPS
+#define SCHED_SMCLK_RADIO	0x04	// RF_TIMESTAMPS clock
+
+typedef void (*EVENT_HANDLER)();
+
+typedef struct {
+	EVENT_HANDLER handler;
+	uint8_t flags;
+} SCHED_EVENT;
+
+// SCHED_PROFILE: dispatch cost, SMCLK ticks from the queue check to a handler's entry
+typedef struct {
+	uint32_t runs;			// handler calls
+	uint32_t cost_total;
+	uint16_t cost_max;
+} SCHED_STATS;
+
+extern const SCHED_EVENT sched_events[];	// events.c, SCHED_EVENTS of them
+extern volatile uint16_t sys_event;		// bit n: event n is pending
+extern volatile uint8_t sched_pending[];	// posts not yet run, per event
+extern volatile uint8_t sched_keep;
+extern uint16_t sched_sleeps;				// times the queue ran dry
+#ifdef POWER_REPORTS
+extern uint32_t sched_asleep;				// timer ticks spent in sched_sleep()
+#endif
+
+// Counts stop at 255; that far behind, a lost post is the least of our problems
+#define sched_post_isr(ev) do { \
+		sys_event |= 1u << (ev); \
+		if (sched_pending[ev] != 0xFF) \
+			sched_pending[ev]++; \
+	} while (0)
+
+void sched_post(uint8_t ev);
+void sched_hold(uint8_t keep);
+void sched_release(uint8_t keep);
+uint16_t sched_run_until_idle();
+void sched_sleep();
+void sched_run();
+
+#ifdef SCHED_PROFILE
+extern SCHED_STATS sched_stats;
+#endif
+
+#endif /* SCHED_H_ */
@@ -0,0 +1,86 @@
+/*
+ * spi_bench.c
+ *
+ * Times payload moves with Timer1_A free running from SMCLK.  CSN is left
+ * deasserted so the transceiver ignores the traffic; only the MSP430 side of
+ * the transfer is being measured.  With BCSCTL2 = DIVS_1 one SMCLK tick is two
+ * MCLK cycles.
+ */
+
+#include <msp430.h>
+#include "nrf_userconfig.h"
+
+#ifdef SPI_BENCHMARK
+
+#include "spi_bench.h"
+#include "msp430_spi.h"
+#include "nRF24L01.h"
+
+static const uint8_t bench_len[SPI_BENCH_SIZES] = { 1, 8, 16, 32 };
+static uint8_t bench_buf[32];
+
+// Payload write as done by w_tx_payload() before the block API
+static void loop16_write(uint8_t len, uint8_t *data) {
+	uint16_t i = 0;
+
+	if (len % 2) {
+		spi_transfer16((RF24_W_TX_PAYLOAD << 8) | (0x00FF & data[0]));
+		i = 1;
+	} else {
+		spi_transfer(RF24_W_TX_PAYLOAD);
+	}
+	for (; i < len; i += 2)
+		spi_transfer16((data[i] << 8) | (0x00FF & data[i + 1]));
+}
+
+// Payload read as done by r_rx_payload() before the block API
+static void loop16_read(uint8_t len, uint8_t *data) {
+	uint16_t i = 0, j;
+
+	if (len % 2) {
+		i = spi_transfer16((RF24_R_RX_PAYLOAD << 8) | RF24_NOP);
+		data[0] = i & 0x00FF;
+		i = 1;
+	} else {
+		spi_transfer(RF24_R_RX_PAYLOAD);
+	}
+	for (; i < len; i += 2) {
+		j = spi_transfer16(0xFFFF);
+		data[i] = (j & 0xFF00) >> 8;
+		data[i + 1] = (j & 0x00FF);
+	}
+}
+
+void spi_bench_run(SPI_BENCH_RESULT *results) {
+	uint8_t n, len;
+	uint16_t start;
+
+	TA1CTL = TASSEL_2 | ID_0 | MC_2 | TACLR;  // SMCLK, continuous mode
+	for (n = 0; n < SPI_BENCH_SIZES; n++) {
+		len = bench_len[n];
+		results[n].len = len;
+
+		_disable_interrupts();
+		start = TA1R;
+		loop16_write(len, bench_buf);
+		results[n].loop16_write = TA1R - start;
+
+		start = TA1R;
+		loop16_read(len, bench_buf);
+		results[n].loop16_read = TA1R - start;
+
+		start = TA1R;
+		spi_transfer(RF24_W_TX_PAYLOAD);
+		spi_write_block(bench_buf, len);
+		results[n].block_write = TA1R - start;
+
+		start = TA1R;
+		spi_transfer(RF24_R_RX_PAYLOAD);
+		spi_read_block(bench_buf, len);
+		results[n].block_read = TA1R - start;
+		_enable_interrupts();
+	}
+	TA1CTL = MC_0;
+}
+
+#endif
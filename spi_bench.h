@@ -0,0 +1,25 @@
+/*
+ * spi_bench.h
+ *
+ * Cycle-count comparison of the old spi_transfer16() payload loop against the
+ * block SPI transfers.  Build with SPI_BENCHMARK defined in nrf_userconfig.h.
+ */
+
+#ifndef SPI_BENCH_H_
+#define SPI_BENCH_H_
+
+#include <stdint.h>
+
+#define SPI_BENCH_SIZES 4	// payload lengths 1, 8, 16, 32
+
+typedef struct {
+	uint8_t len;
+	uint16_t loop16_write;	// SMCLK ticks, spi_transfer16() loop (old w_tx_payload)
+	uint16_t loop16_read;	// SMCLK ticks, spi_transfer16() loop (old r_rx_payload)
+	uint16_t block_write;	// SMCLK ticks, spi_write_block()
+	uint16_t block_read;	// SMCLK ticks, spi_read_block()
+} SPI_BENCH_RESULT;
+
+void spi_bench_run(SPI_BENCH_RESULT *results);
+
+#endif /* SPI_BENCH_H_ */
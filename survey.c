@@ -0,0 +1,113 @@
+/*
+ * survey.c
+ *
+ * Sweeps channels 0-125 with the radio in PRX, taking one RPD sample per timer
+ * tick so the main loop keeps servicing other events between samples.  Each
+ * channel's hit count is printed as one hex digit as soon as it is done, and
+ * the quietest channels are reported at the end.  The link is paused while the
+ * survey owns the radio and resumed on the original channel afterwards; the hit
+ * counts live in the idle packet pool meanwhile.
+ */
+
+#include "msp430.h"
+#include "survey.h"
+#include "nrf24api.h"
+#include "msprf24.h"
+#include "uart.h"
+#include "stdint.h"
+#include "log.h"
+#include "events.h"
+#include "timer.h"
+#include <string.h>
+
+volatile uint8_t survey_running = 0;
+
+static uint8_t *hits;		// 4-bit RPD hit count per channel, (SURVEY_CHANNELS + 1) / 2 bytes
+static uint8_t quiet[SURVEY_RECOMMEND];
+static uint8_t channel;
+static uint8_t sample;
+static TIMER survey_timer = TIMER_EVENT(SURVEY_EVENT);	// every tick while running
+
+// Only valid until the survey hands the pool back to the radio
+uint8_t survey_hits(uint8_t ch) {
+	if (ch >= SURVEY_CHANNELS)
+		return 0x0F;
+	return (ch & 1) ? hits[ch >> 1] >> 4 : hits[ch >> 1] & 0x0F;
+}
+
+// Quietest channels of the last survey, best first
+uint8_t survey_channel(uint8_t n) {
+	return quiet[n];
+}
+
+// Channel busyness weighted with its neighbours, a quiet channel next to a busy one is no bargain
+static uint8_t survey_score(uint8_t ch) {
+	uint8_t score = survey_hits(ch) << 1;
+
+	score += ch ? survey_hits(ch - 1) : 0x0F;
+	score += survey_hits(ch + 1);
+	return score;
+}
+
+static void survey_recommend() {
+	uint8_t n, m, ch, score, best;
+
+	for (n = 0; n < SURVEY_RECOMMEND; n++) {
+		best = 0xFF;
+		quiet[n] = 0;
+		for (ch = 0; ch < SURVEY_CHANNELS; ch++) {
+			for (m = 0; m < n; m++) {	// keep recommendations 2MHz apart
+				if (ch + 1 >= quiet[m] && ch <= quiet[m] + 1)
+					break;
+			}
+			if (m < n)
+				continue;
+			score = survey_score(ch);
+			if (score < best) {
+				best = score;
+				quiet[n] = ch;
+			}
+		}
+	}
+	LOG(LOG_QUIET, quiet[0], quiet[1], quiet[2]);
+}
+
+void survey_start() {
+	if (survey_running)
+		return;
+	hits = radio_pause();
+	if (!hits)
+		return;
+	memset(hits, 0, (SURVEY_CHANNELS + 1) / 2);
+	channel = 0;
+	sample = 0;
+	msprf24_activate_rx();
+	msprf24_scan_tune(channel);
+	print("\n\rsurvey: ");
+	survey_running = 1;
+	timer_start(&survey_timer, 1, 1);
+}
+
+// One RPD sample; called on SURVEY_EVENT, which survey_timer posts every tick while running
+void survey_step() {
+	static const char hex_table[] = "0123456789abcdef";
+
+	if (!survey_running || ++sample <= SURVEY_SETTLE)
+		return;
+	if (msprf24_scan_rpd())
+		hits[channel >> 1] += (channel & 1) ? 0x10 : 0x01;
+	if (sample < SURVEY_SETTLE + SURVEY_SAMPLES)
+		return;
+
+	sample = 0;
+	putchar(hex_table[survey_hits(channel)]);
+	if (++channel < SURVEY_CHANNELS) {
+		msprf24_scan_tune(channel);
+		return;
+	}
+
+	survey_running = 0;
+	timer_stop(&survey_timer);
+	survey_recommend();
+	radio_resume();
+}
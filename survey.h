@@ -0,0 +1,27 @@
+/*
+ * survey.h
+ *
+ * Background 2.4GHz spectrum survey across all nRF24 channels.
+ */
+
+#ifndef SURVEY_H_
+#define SURVEY_H_
+
+#include "stdint.h"
+#include "interrupts.h"
+
+#define SURVEY_CHANNELS		126
+#define SURVEY_SAMPLES		15	// RPD samples per channel, one per timer tick (fits a nibble)
+#define SURVEY_SETTLE		((TICK_HZ * 17UL + 99999) / 100000)	// ticks after retuning before RPD is valid (~170us)
+#define SURVEY_RECOMMEND	3	// # of quiet channels recommended at the end
+
+//function prototypes
+void survey_start();
+void survey_step();
+uint8_t survey_hits(uint8_t ch);
+uint8_t survey_channel(uint8_t n);
+
+//variables
+extern volatile uint8_t survey_running;
+
+#endif /* SURVEY_H_ */
@@ -0,0 +1,127 @@
+/*
+ * timer.c
+ *
+ * Hashed timer wheel, see timer.h.  timer_tick() runs in the timer ISR, everything
+ * else may be called from anywhere.
+ */
+
+#include <msp430.h>
+#include "timer.h"
+#include "sched.h"
+#include "interrupts.h"
+#include "trace.h"
+
+static TIMER *wheel[TIMER_SLOTS];
+static uint16_t timer_done = 0;		// tick the wheel has been run up to
+
+// Interrupts off
+static void timer_link(TIMER *t) {
+	TIMER **slot = &wheel[t->expires & (TIMER_SLOTS - 1)];
+
+	t->next = *slot;
+	if (t->next)
+		t->next->link = &t->next;
+	t->link = slot;
+	*slot = t;
+}
+
+// Interrupts off
+static void timer_unlink(TIMER *t) {
+	*t->link = t->next;
+	if (t->next)
+		t->next->link = t->link;
+	t->link = 0;
+}
+
+#ifdef TICKLESS
+/* Timer0_A CCR1 interrupts at tick at.  Written after TA0R may already have got
+ * there, so that case raises the interrupt by hand.  Interrupts off
+ */
+static void timer_deadline(uint16_t at) {
+	TA0CCR1 = at;
+	TA0CCTL1 |= CCIE;
+	if ((uint16_t)(at - clock_ticks() - 1) >= 0x8000)
+		TA0CCTL1 |= CCIFG;
+}
+
+/* Point CCR1 at the earliest armed timer, at most half the clock's range out.  Slots
+ * are looked at in the order their ticks come up, so a timer due within one lap ends
+ * the search at its slot; only when none is does every timer get looked at.
+ */
+static void timer_program(uint16_t now) {
+	uint16_t next = 0x7FFF, left;
+	uint8_t k;
+	TIMER *t;
+
+	for (k = 1; k <= TIMER_SLOTS && next > TIMER_SLOTS; k++) {
+		for (t = wheel[(now + k) & (TIMER_SLOTS - 1)]; t; t = t->next) {
+			left = t->expires - now;
+			if (left < next)
+				next = left;
+		}
+	}
+	timer_deadline(now + next);
+}
+#endif
+
+// (Re)arm t to go off delay ticks from now, then every period ticks if period isn't 0
+void timer_start(TIMER *t, uint16_t delay, uint16_t period) {
+	uint16_t state = __get_interrupt_state(), now;
+
+	__disable_interrupt();
+	if (t->link)
+		timer_unlink(t);
+	now = clock_ticks();
+	t->expires = now + (delay ? delay : 1);
+	t->period = period;
+	timer_link(t);
+#ifdef TICKLESS
+	if (!(TA0CCTL1 & CCIE) || (uint16_t)(t->expires - now) < (uint16_t)(TA0CCR1 - now))
+		timer_deadline(t->expires);  // Sooner than what we'd wake for
+#endif
+	__set_interrupt_state(state);
+}
+
+void timer_stop(TIMER *t) {
+	uint16_t state = __get_interrupt_state();
+
+	__disable_interrupt();
+	if (t->link)
+		timer_unlink(t);
+	__set_interrupt_state(state);
+}
+
+/* Fire what fell due since the last call, up to and including tick now; returns
+ * nonzero if a callback asked for a wakeup.  With the WDT that is always one tick, so
+ * one slot.  Tickless it can be many, but no more than TIMER_SLOTS slots are looked at.
+ */
+uint8_t timer_tick(uint16_t now) {
+	uint16_t base = timer_done, span = now - base, at = base + 1;
+	uint8_t slots = span < TIMER_SLOTS ? span : TIMER_SLOTS, wake = 0;
+	TIMER *t, *next;
+
+	timer_done = now;
+	for (; slots; slots--, at++) {
+		for (t = wheel[at & (TIMER_SLOTS - 1)]; t; t = next) {
+			next = t->next;
+			if ((uint16_t)(t->expires - base - 1) >= span)
+				continue;  // A later lap
+			timer_unlink(t);
+			if (t->period) {
+				t->expires += t->period;
+				if ((uint16_t)(t->expires - now - 1) >= 0x8000)
+					t->expires = now + 1;  // Fell behind by more than a period
+				timer_link(t);
+			}
+			TRACE_ISR(TRACE_TIMER, t->event);  // TIMER_NO_EVENT: a callback
+			if (t->event != TIMER_NO_EVENT)
+				sched_post_isr(t->event);
+			if (t->call)
+				wake |= t->call(t);
+		}
+	}
+#ifdef TICKLESS
+	timer_program(now);
+#endif
+	return wake;
+}
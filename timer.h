@@ -0,0 +1,44 @@
+/*
+ * timer.h
+ *
+ * One-shot and periodic software timers on the tick of interrupts.c (the WDT, or
+ * Timer0_A from ACLK with TICKLESS), kept in a hashed wheel: a timer due at tick T
+ * sits in slot T % TIMER_SLOTS, so starting and stopping are a list insert/unlink and
+ * a tick only looks at the one slot that can be due.  An expired timer posts its
+ * event, or calls its callback from the timer ISR; a callback returns nonzero to wake
+ * the main loop.
+ *
+ * Delays run 1-65535 ticks.  Callbacks may restart or stop their own timer, not others.
+ */
+
+#ifndef TIMER_H_
+#define TIMER_H_
+
+#include <stdint.h>
+
+#define TIMER_SLOTS		8		// power of two, more than the timers armed at once (five)
+#define TIMER_NO_EVENT	0xFF
+
+typedef struct TIMER TIMER;
+typedef uint8_t (*TIMER_CALLBACK)(TIMER *t);
+
+struct TIMER {
+	TIMER *next;
+	TIMER **volatile link;	// what points at us, 0 = not armed
+	uint16_t expires;		// tick
+	uint16_t period;		// 0 = one-shot
+	TIMER_CALLBACK call;
+	uint8_t event;
+};
+
+// Static initializers
+#define TIMER_EVENT(ev)		{ 0, 0, 0, 0, 0, ev }
+#define TIMER_CALL(fn)		{ 0, 0, 0, 0, fn, TIMER_NO_EVENT }
+
+void timer_start(TIMER *t, uint16_t delay, uint16_t period);
+void timer_stop(TIMER *t);
+uint8_t timer_tick(uint16_t now);
+
+#define timer_armed(t)		((t)->link != 0)
+
+#endif /* TIMER_H_ */
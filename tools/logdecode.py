@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+"""Turn the firmware's binary LOG() records back into text.
+
+The format table is read from log_ids.h, the same X() list the firmware ids are
+built from.  Input is a capture file, stdin, or a serial port (needs pyserial):
+
+    logdecode.py capture.bin
+    logdecode.py --port /dev/ttyACM0 --baud 9600
+    logdecode.py --table          # dump the id table and exit
+
+Bytes that aren't part of a valid record are copied through as they are.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+LOG_SYNC = 0x1E
+LOG_HEADER = 3
+LOG_MAX_WORDS = 8
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_TABLE = os.path.join(HERE, '..', 'log_ids.h')
+
+ENTRY = re.compile(r'X\(\s*(\w+)\s*,\s*("(?:[^"\\]|\\.)*")\s*\)')
+CONV = re.compile(r'%(-?\d*)(l?)([udx])')
+
+
+def c_unescape(literal):
+    return literal[1:-1].encode('latin-1').decode('unicode_escape')
+
+
+def load_table(path):
+    """[(name, format, [(conversion, words)...]), ...] in id order."""
+    with open(path) as f:
+        text = f.read()
+    table = []
+    for name, literal in ENTRY.findall(text):
+        fmt = c_unescape(literal)
+        convs = [(m.group(3), 2 if m.group(2) else 1) for m in CONV.finditer(fmt)]
+        table.append((name, CONV.sub(r'%\1\3', fmt), convs))
+    return table
+
+
+def render(entry, words):
+    name, fmt, convs = entry
+    values, at = [], 0
+    for conv, size in convs:
+        if size == 2:
+            value = words[at] | words[at + 1] << 16
+            if conv == 'd' and value & 0x80000000:
+                value -= 1 << 32
+        else:
+            value = words[at]
+            if conv == 'd' and value & 0x8000:
+                value -= 1 << 16
+        values.append(value)
+        at += size
+    return fmt % tuple(values)
+
+
+class Decoder:
+    def __init__(self, table):
+        self.table = table
+        self.pending = bytearray()
+
+    def _record_words(self, data):
+        """Word count of the record header at data[0], None if it isn't one."""
+        ident, words = data[1], data[2]
+        if ident >= len(self.table) or words > LOG_MAX_WORDS:
+            return None
+        if words != sum(size for _, size in self.table[ident][2]):
+            return None
+        return words
+
+    def split(self, data):
+        """Cut as much as possible into records and the bytes between them: a list of
+        bytes objects and (id, words) tuples, in stream order."""
+        self.pending += data
+        out = []
+        while self.pending:
+            at = self.pending.find(LOG_SYNC)
+            if at < 0:
+                out.append(bytes(self.pending))
+                self.pending.clear()
+                break
+            if at:
+                out.append(bytes(self.pending[:at]))
+                del self.pending[:at]
+            if len(self.pending) < LOG_HEADER:
+                break  # rest of the header hasn't arrived
+            words = self._record_words(self.pending)
+            if words is None:
+                out.append(bytes(self.pending[:1]))
+                del self.pending[:1]
+                continue
+            length = LOG_HEADER + 2 * words
+            if len(self.pending) < length:
+                break  # rest of the record hasn't arrived
+            args = struct.unpack_from('<%dH' % words, self.pending, LOG_HEADER)
+            out.append((self.pending[1], args))
+            del self.pending[:length]
+        return out
+
+    def feed(self, data):
+        """Decode as much as possible, returns the text so far."""
+        out = []
+        for item in self.split(data):
+            if isinstance(item, tuple):
+                out.append(render(self.table[item[0]], item[1]))
+            else:
+                out.append(item.decode('latin-1'))
+        return ''.join(out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('input', nargs='?', help='capture file, stdin if omitted')
+    ap.add_argument('--ids', default=DEFAULT_TABLE, help='log_ids.h to decode with')
+    ap.add_argument('--port', help='read a serial port instead')
+    ap.add_argument('--baud', type=int, default=9600)
+    ap.add_argument('--table', action='store_true', help='print the id table and exit')
+    args = ap.parse_args()
+
+    table = load_table(args.ids)
+    if args.table:
+        for ident, (name, fmt, convs) in enumerate(table):
+            print('%3d %-16s %d words  %r' % (ident, name, sum(s for _, s in convs), fmt))
+        return
+
+    decoder = Decoder(table)
+    if args.port:
+        import serial
+        src = serial.Serial(args.port, args.baud, timeout=0.1)
+        read = lambda: src.read(256)
+    else:
+        src = open(args.input, 'rb') if args.input else sys.stdin.buffer
+        read = lambda: src.read1(256) if hasattr(src, 'read1') else src.read(256)
+
+    try:
+        while True:
+            data = read()
+            if not data and not args.port:
+                break
+            sys.stdout.write(decoder.feed(data))
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+    sys.stdout.write(decoder.pending.decode('latin-1'))
+
+
+if __name__ == '__main__':
+    main()
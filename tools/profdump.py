@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Fetch the firmware's PROFILE table and print it in MCLK cycles.
+
+Probe names come from prof.h, record ids from log_ids.h (see logdecode.py).  With
+--port the request { 0, 0, UART_PROF_REQ } is sent and the answer read back (needs
+pyserial); otherwise a capture file or stdin holding the answer is read:
+
+    profdump.py --port /dev/ttyACM0 --baud 9600
+    profdump.py capture.bin
+
+Cycle figures have the probe's own overhead taken off.  Anything else on the line
+(log records, radio data) is skipped.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+from logdecode import DEFAULT_TABLE, Decoder, load_table
+
+UART_PROF_REQ = 0xB0
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_PROBES = os.path.join(HERE, '..', 'prof.h')
+
+PROBE = re.compile(r'X\(\s*(PROF_\w+)\s*,\s*"([^"]*)"\s*\)')
+
+
+def load_probes(path):
+    with open(path) as f:
+        return [name for _, name in PROBE.findall(f.read())]
+
+
+def u32(words, at):
+    return words[at] | words[at + 1] << 16
+
+
+class Profile:
+    def __init__(self, ids):
+        names = [name for name, _, _ in ids]
+        self.head_id = names.index('LOG_PROF_HEAD')
+        self.prof_id = names.index('LOG_PROF')
+        self.probes = None   # count from the header
+        self.scale = 1
+        self.overhead = 0
+        self.rows = {}
+
+    def take(self, ident, words):
+        if ident == self.head_id:
+            self.probes, self.scale, self.overhead = words
+            self.rows = {}
+        elif ident == self.prof_id and self.probes is not None:
+            self.rows[words[0]] = (u32(words, 1), words[3], words[4], u32(words, 5))
+
+    def complete(self):
+        return self.probes is not None and len(self.rows) == self.probes
+
+    def table(self, names):
+        out = ['%-16s %10s %8s %8s %8s %12s %6s' %
+               ('probe', 'calls', 'min', 'avg', 'max', 'total', '%')]
+        grand = sum(max(total - count * self.overhead, 0)
+                    for count, _, _, total in self.rows.values()) or 1
+        for probe in sorted(self.rows):
+            count, low, high, total = self.rows[probe]
+            name = names[probe] if probe < len(names) else 'probe %d' % probe
+            if not count:
+                out.append('%-16s %10d' % (name, 0))
+                continue
+            net = max(total - count * self.overhead, 0)
+            out.append('%-16s %10d %8d %8d %8d %12d %6.1f' % (
+                name, count,
+                max(low - self.overhead, 0) * self.scale,
+                net * self.scale // count,
+                max(high - self.overhead, 0) * self.scale,
+                net * self.scale,
+                100.0 * net / grand))
+        out.append('(cycles at %d per tick, %d ticks probe overhead taken off)' %
+                   (self.scale, self.overhead))
+        return '\n'.join(out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('input', nargs='?', help='capture file, stdin if omitted')
+    ap.add_argument('--ids', default=DEFAULT_TABLE, help='log_ids.h to decode with')
+    ap.add_argument('--probes', default=DEFAULT_PROBES, help='prof.h to name probes from')
+    ap.add_argument('--port', help='ask a serial port instead')
+    ap.add_argument('--baud', type=int, default=9600)
+    ap.add_argument('--timeout', type=float, default=3.0, help='seconds to wait with --port')
+    args = ap.parse_args()
+
+    ids = load_table(args.ids)
+    decoder = Decoder(ids)
+    profile = Profile(ids)
+
+    if args.port:
+        import serial
+        import time
+        src = serial.Serial(args.port, args.baud, timeout=0.1)
+        src.write(bytes((0, 0, UART_PROF_REQ)))
+        deadline = time.time() + args.timeout
+        read = lambda: src.read(256) if time.time() < deadline else None
+    else:
+        src = open(args.input, 'rb') if args.input else sys.stdin.buffer
+        read = lambda: src.read(256) or None
+
+    while not profile.complete():
+        data = read()
+        if data is None:
+            break
+        for item in decoder.split(data):
+            if isinstance(item, tuple):
+                profile.take(*item)
+
+    if profile.probes is None:
+        sys.exit('no profile received')
+    print(profile.table(load_probes(args.probes)))
+    if not profile.complete():
+        sys.exit('incomplete: %d of %d probes' % (len(profile.rows), profile.probes))
+
+
+if __name__ == '__main__':
+    main()
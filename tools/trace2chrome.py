@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+"""Fetch the firmware's trace ring (TRACE_ENABLE) and write it as a Chrome trace.
+
+Kind names and rows come from trace.h, record ids from log_ids.h (see logdecode.py),
+event names from events.h.  With --port the request { 0, 0, UART_TRACE_REQ } is
+sent and the answer read back (needs pyserial); otherwise a capture file or stdin
+holding the answer is read:
+
+    trace2chrome.py --port /dev/ttyACM0 --baud 9600 -o trace.json
+    trace2chrome.py capture.bin --text
+
+Open the JSON in chrome://tracing or ui.perfetto.dev.  A dispatch lasts until the
+next entry in the main row, a sleep until the next entry of any kind; everything
+else is an instant.  Times are relative to the oldest entry.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+from logdecode import DEFAULT_TABLE, Decoder, load_table
+
+UART_TRACE_REQ = 0xB1
+TRACE_EMPTY = 0xFF
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_KINDS = os.path.join(HERE, '..', 'trace.h')
+DEFAULT_EVENTS = os.path.join(HERE, '..', 'events.h')
+DEFAULT_STEPS = os.path.join(HERE, '..', 'nrf24api.c')
+
+KIND = re.compile(r'X\(\s*(TRACE_\w+)\s*,\s*"([^"]*)"\s*,\s*"([^"]*)"\s*\)')
+EVENT = re.compile(r'#define\s+(\w+)_EVENT\s+(\d+)')
+STEP = re.compile(r'#define\s+RADIO_(\w+)\s+(\d+)')
+RESET = ((0x04, 'por'), (0x08, 'rst'), (0x01, 'wdt'))  # IFG1 bits
+
+
+def load_kinds(path):
+    """[(id, name, row), ...] in kind order."""
+    with open(path) as f:
+        return KIND.findall(f.read())
+
+
+def load_defines(path, pattern):
+    with open(path) as f:
+        return {int(value): name.lower() for name, value in pattern.findall(f.read())}
+
+
+class Trace:
+    def __init__(self, ids):
+        names = [name for name, _, _ in ids]
+        self.head_id = names.index('LOG_TRACE_HEAD')
+        self.entry_id = names.index('LOG_TRACE')
+        self.size = None   # from the header
+        self.entries = []
+
+    def take(self, ident, words):
+        if ident == self.head_id:
+            self.size, self.written, self.hz, self.boots = words
+            self.entries = []
+        elif ident == self.entry_id and self.size is not None:
+            self.entries.append((words[0], words[1] & 0xFF, words[1] >> 8))
+
+    def complete(self):
+        return self.size is not None and len(self.entries) == min(self.size, self.written)
+
+    def timeline(self):
+        """(microseconds, kind, arg) with the 16 bit tick unwrapped, oldest first."""
+        out, t, last = [], 0, None
+        for tick, kind, arg in self.entries:
+            if kind == TRACE_EMPTY:
+                continue
+            if last is not None:
+                t += (tick - last) & 0xFFFF
+            last = tick
+            out.append((t * 1e6 / self.hz, kind, arg))
+        return out
+
+
+def describe(kinds, events, steps, kind, arg):
+    if kind >= len(kinds):
+        return 'kind %d' % kind, 'main', arg
+    ident, name, row = kinds[kind]
+    if ident == 'TRACE_DISPATCH':
+        return events.get(arg, 'event %d' % arg), row, arg
+    if ident == 'TRACE_TIMER':
+        return 'timer ' + (events.get(arg, 'call') if arg != 0xFF else 'call'), row, arg
+    if ident == 'TRACE_RADIO_STEP':
+        return steps.get(arg, 'step %d' % arg), row, arg
+    if ident == 'TRACE_SLEEP':
+        return 'lpm%d' % arg, row, arg
+    if ident == 'TRACE_BOOT':
+        return 'boot ' + ('/'.join(n for bit, n in RESET if arg & bit) or '?'), row, arg
+    return name, row, arg
+
+
+def chrome(timeline, kinds, events, steps):
+    rows, out = {}, []
+    named = [describe(kinds, events, steps, kind, arg) for _, kind, arg in timeline]
+    for i, ((us, kind, arg), (name, row, _)) in enumerate(zip(timeline, named)):
+        tid = rows.setdefault(row, len(rows) + 1)
+        end = None
+        if name.startswith('lpm'):
+            end = timeline[i + 1][0] if i + 1 < len(timeline) else None
+        elif kind < len(kinds) and kinds[kind][0] == 'TRACE_DISPATCH':
+            end = next((timeline[j][0] for j in range(i + 1, len(timeline))
+                        if named[j][1] == 'main'), None)
+        event = {'name': name, 'pid': 1, 'tid': tid, 'ts': us, 'args': {'arg': arg}}
+        if end is None:
+            event.update(ph='i', s='t')
+        else:
+            event.update(ph='X', dur=end - us)
+        out.append(event)
+    for row, tid in rows.items():
+        out.append({'name': 'thread_name', 'ph': 'M', 'pid': 1, 'tid': tid,
+                    'args': {'name': row}})
+    return {'traceEvents': out, 'displayTimeUnit': 'ns'}
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('input', nargs='?', help='capture file, stdin if omitted')
+    ap.add_argument('-o', '--output', help='JSON file, stdout if omitted')
+    ap.add_argument('--text', action='store_true', help='print a timeline instead of JSON')
+    ap.add_argument('--ids', default=DEFAULT_TABLE, help='log_ids.h to decode with')
+    ap.add_argument('--kinds', default=DEFAULT_KINDS, help='trace.h to name kinds from')
+    ap.add_argument('--events', default=DEFAULT_EVENTS, help='events.h to name events from')
+    ap.add_argument('--steps', default=DEFAULT_STEPS, help='nrf24api.c to name radio steps from')
+    ap.add_argument('--port', help='ask a serial port instead')
+    ap.add_argument('--baud', type=int, default=9600)
+    ap.add_argument('--timeout', type=float, default=3.0, help='seconds to wait with --port')
+    args = ap.parse_args()
+
+    ids = load_table(args.ids)
+    decoder = Decoder(ids)
+    trace = Trace(ids)
+
+    if args.port:
+        import serial
+        import time
+        src = serial.Serial(args.port, args.baud, timeout=0.1)
+        src.write(bytes((0, 0, UART_TRACE_REQ)))
+        deadline = time.time() + args.timeout
+        read = lambda: src.read(256) if time.time() < deadline else None
+    else:
+        src = open(args.input, 'rb') if args.input else sys.stdin.buffer
+        read = lambda: src.read(256) or None
+
+    while not trace.complete():
+        data = read()
+        if data is None:
+            break
+        for item in decoder.split(data):
+            if isinstance(item, tuple):
+                trace.take(*item)
+
+    if trace.size is None:
+        sys.exit('no trace received')
+    kinds = load_kinds(args.kinds)
+    events = load_defines(args.events, EVENT)
+    steps = load_defines(args.steps, STEP)
+    timeline = trace.timeline()
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    if args.text:
+        out.write('%d entries, %d written, boot %d\n' % (len(timeline), trace.written, trace.boots))
+        last = 0
+        for us, kind, arg in timeline:
+            name, row, _ = describe(kinds, events, steps, kind, arg)
+            out.write('%12.1f %+10.1f  %-6s %s\n' % (us, us - last, row, name))
+            last = us
+    else:
+        json.dump(chrome(timeline, kinds, events, steps), out, indent=1)
+        out.write('\n')
+    if not trace.complete():
+        sys.exit('incomplete: %d of %d entries' % (len(trace.entries), min(trace.size, trace.written)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,102 @@
+/*
+ * trace.c
+ *
+ * Trace ring, see trace.h.
+ */
+
+#include <msp430.h>
+#include <string.h>
+#include "nrf_userconfig.h"
+
+#ifdef TRACE_ENABLE
+
+#include "trace.h"
+#include "interrupts.h"
+#include "log.h"
+#include "uart.h"
+
+#if TRACE_ENTRIES & (TRACE_ENTRIES - 1)
+#error "TRACE_ENTRIES must be a power of two"
+#endif
+
+// Left alone by the C startup, see trace_init()
+#ifdef __GNUC__
+TRACE_RING trace_ring __attribute__((section(".noinit")));
+#else
+#pragma NOINIT(trace_ring)
+TRACE_RING trace_ring;
+#endif
+
+#define DUMP_IDLE	0
+#define DUMP_HEAD	1		// LOG_TRACE_HEAD next
+#define DUMP_ENTRIES	2
+
+static uint8_t dumping = DUMP_IDLE;
+static uint16_t dump_next, dump_end;
+
+/* First thing after reset: keep what the last run left unless the power was off
+ * (RAM is noise then), and mark the boot with the reset flags.
+ */
+void trace_init() {
+	uint8_t flags = IFG1 & (PORIFG | RSTIFG | WDTIFG);
+
+	IFG1 &= ~(PORIFG | RSTIFG | WDTIFG);
+	if (trace_ring.magic != TRACE_MAGIC || (flags & PORIFG)) {
+		memset(&trace_ring, 0, sizeof(trace_ring));
+		memset(trace_ring.ring, TRACE_EMPTY, sizeof(trace_ring.ring));
+		trace_ring.magic = TRACE_MAGIC;
+	}
+	trace_ring.boots++;
+	trace_isr(TRACE_BOOT, flags);
+}
+
+// Interrupts off
+void trace_isr(uint8_t kind, uint8_t arg) {
+	TRACE_ENTRY *e;
+
+	if (dumping)
+		return;
+	e = &trace_ring.ring[trace_ring.head++ & (TRACE_ENTRIES - 1)];
+	e->time = clock_ticks();
+	e->kind = kind;
+	e->arg = arg;
+}
+
+void trace(uint8_t kind, uint8_t arg) {
+	uint16_t state = __get_interrupt_state();
+
+	__disable_interrupt();
+	trace_isr(kind, arg);
+	__set_interrupt_state(state);
+}
+
+// Freeze the ring and queue it for the UART; it goes out from trace_dump_poll()
+void trace_dump() {
+	if (dumping)
+		return;
+	dumping = DUMP_HEAD;
+	dump_end = trace_ring.head;
+	dump_next = dump_end - TRACE_ENTRIES;
+	trace_dump_poll();
+}
+
+// From UART_TX_EVENT: as many entries as the TX ring has room for
+void trace_dump_poll() {
+	TRACE_ENTRY *e;
+
+	while (dumping && uart_tx_room() >= LOG_RECORD_MAX) {
+		if (dumping == DUMP_HEAD) {
+			LOG(LOG_TRACE_HEAD, TRACE_ENTRIES, dump_end, TICK_HZ, trace_ring.boots);
+			dumping = DUMP_ENTRIES;
+		} else if (dump_next == dump_end) {
+			dumping = DUMP_IDLE;
+			trace(TRACE_DUMP, 0);
+		} else {
+			e = &trace_ring.ring[dump_next++ & (TRACE_ENTRIES - 1)];
+			if (e->kind != TRACE_EMPTY)
+				LOG(LOG_TRACE, e->time, e->kind | (uint16_t)e->arg << 8);
+		}
+	}
+}
+
+#endif
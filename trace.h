@@ -0,0 +1,74 @@
+/*
+ * trace.h
+ *
+ * Trace ring (TRACE_ENABLE in nrf_userconfig.h): the last TRACE_ENTRIES things that happened,
+ * each a { tick, kind, arg } of 4 bytes.  Scheduler dispatches, ISR entries and radio
+ * state changes are recorded, at the cost of one short function call each; the ring
+ * itself takes 38 bytes of RAM.  It is kept out of the C startup's zeroing and is
+ * only cleared at power-on, so after a watchdog or RST reset the dump still shows
+ * what led up to it, ending in a TRACE_BOOT with the reset flags.
+ *
+ * The host sends { 0, 0, UART_TRACE_REQ } for a dump, see uart.h: a LOG_TRACE_HEAD
+ * record, then the entries oldest first as LOG_TRACE records.  Recording pauses while
+ * the dump goes out and a TRACE_DUMP marks the gap.  tools/trace2chrome.py turns the
+ * dump into a Chrome trace (chrome://tracing, Perfetto) with the names below; the
+ * third column is the row an entry is drawn in.  Append new kinds at the end.
+ *
+ * Ticks are clock_ticks(), TICK_HZ a second; the once a second timer keeps entries
+ * close enough together for the host to unwrap them.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+#include "nrf_userconfig.h"
+
+#define TRACE_KINDS \
+	X(TRACE_BOOT,		"boot",		"main") \
+	X(TRACE_DISPATCH,	"dispatch",	"main") \
+	X(TRACE_SLEEP,		"sleep",	"main") \
+	X(TRACE_TIMER,		"timer",	"isr") \
+	X(TRACE_UART_RX,	"uart rx",	"isr") \
+	X(TRACE_UART_TX,	"uart tx",	"isr") \
+	X(TRACE_RADIO_IRQ,	"radio irq",	"isr") \
+	X(TRACE_RADIO_WAIT,	"radio wait",	"isr") \
+	X(TRACE_BUTTON,		"button",	"isr") \
+	X(TRACE_RADIO_STEP,	"radio step",	"radio") \
+	X(TRACE_DUMP,		"dump",		"main")
+
+#define X(id, name, row)	id,
+typedef enum { TRACE_KINDS TRACE_KIND_COUNT } TRACE_KIND;
+#undef X
+
+#define TRACE_ENTRIES	8		// power of two; the PTX's RAM budget has no room for more
+#define TRACE_MAGIC		0x7ACE
+#define TRACE_EMPTY		0xFF	// kind of a slot not written since power-on
+
+typedef struct {
+	uint16_t time;		// clock_ticks()
+	uint8_t kind;
+	uint8_t arg;
+} TRACE_ENTRY;
+
+typedef struct {
+	uint16_t magic;		// TRACE_MAGIC: the rest is from before a reset, not noise
+	uint16_t head;		// entries ever written, the next goes to head % TRACE_ENTRIES
+	uint16_t boots;
+	TRACE_ENTRY ring[TRACE_ENTRIES];
+} TRACE_RING;
+
+#ifdef TRACE_ENABLE
+void trace_init();
+void trace_isr(uint8_t kind, uint8_t arg);
+void trace(uint8_t kind, uint8_t arg);
+void trace_dump();
+void trace_dump_poll();
+#define TRACE_ISR(kind, arg)	trace_isr(kind, arg)	// interrupts off
+#define TRACE(kind, arg)		trace(kind, arg)
+#else
+#define TRACE_ISR(kind, arg)
+#define TRACE(kind, arg)
+#endif
+
+#endif /* TRACE_H_ */
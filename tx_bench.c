@@ -0,0 +1,140 @@
+/*
+ * tx_bench.c
+ *
+ * Times TX_BENCH_PACKETS full payloads each way with Timer1_A counting SMCLK/8
+ * (1us at 8MHz), extended to 32 bits by the overflow interrupt.  A payload that
+ * hits MAX_RT is retried rather than dropped so both ACKed runs move the same
+ * data; a run is cut short after TX_BENCH_STALLS of them.  The radio must be
+ * powered up with the TX address set, i.e. run it once the link is up.
+ */
+
+#include <msp430.h>
+#include "nrf_userconfig.h"
+
+#ifdef TX_BENCHMARK
+
+#include "tx_bench.h"
+#include "msprf24.h"
+
+static uint8_t bench_buf[32];
+static volatile uint16_t bench_hi;
+
+void tx_bench_clock_start() {
+	bench_hi = 0;
+	TA1CTL = TASSEL_2 | ID_3 | MC_2 | TACLR | TAIE;  // SMCLK/8, continuous mode
+}
+
+uint32_t tx_bench_clock() {
+	uint16_t hi, lo;
+
+	do {
+		hi = bench_hi;
+		lo = TA1R;
+	} while (hi != bench_hi);
+	return ((uint32_t)hi << 16) | lo;
+}
+
+void tx_bench_clock_stop() {
+	TA1CTL = MC_0;
+}
+
+// Wait for TX_DS/MAX_RT, clear it and return the reason
+static uint8_t bench_wait() {
+	uint8_t reason;
+
+	while (!(rf_irq & RF24_IRQ_FLAGGED))
+		;
+	reason = msprf24_get_irq_reason();
+	msprf24_irq_clear(RF24_IRQ_TX | RF24_IRQ_TXFAILED);
+	return reason;
+}
+
+static void bench_fill() {
+	uint8_t i;
+
+	for (i = 0; i < sizeof(bench_buf); i++)
+		bench_buf[i] = i;  // w_tx_payload() clears the caller's copy
+}
+
+void tx_bench_run(TX_BENCH_RESULT *result) {
+	uint8_t sent, stalls;
+	uint32_t start;
+
+	flush_tx();
+	msprf24_irq_clear(RF24_IRQ_TX | RF24_IRQ_TXFAILED);
+	tx_bench_clock_start();
+
+	// Per-packet: Standby-I, CE pulse, wait for the ACK
+	stalls = 0;
+	start = tx_bench_clock();
+	for (sent = 0; sent < TX_BENCH_PACKETS && stalls < TX_BENCH_STALLS; ) {
+		bench_fill();
+		w_tx_payload(32, bench_buf);
+		msprf24_activate_tx();
+		while (bench_wait() & RF24_IRQ_TXFAILED) {
+			if (++stalls >= TX_BENCH_STALLS)
+				break;
+			msprf24_activate_tx();  // Same payload again
+		}
+		sent++;
+	}
+	result->packet_us = tx_bench_clock() - start;
+	result->packet_stalls = stalls;
+	flush_tx();
+
+	/* Streaming: CE stays high and the FIFO is refilled after every TX_DS.  TX_DS may
+	 * cover more than one packet, so completion is judged from an empty FIFO.
+	 */
+	stalls = 0;
+	sent = 0;
+	start = tx_bench_clock();
+	msprf24_stream_tx();
+	while (stalls < TX_BENCH_STALLS) {
+		while (sent < TX_BENCH_PACKETS && !(msprf24_queue_state() & RF24_QUEUE_TXFULL)) {
+			bench_fill();
+			w_tx_payload(32, bench_buf);
+			sent++;
+		}
+		if (sent == TX_BENCH_PACKETS && (msprf24_queue_state() & RF24_QUEUE_TXEMPTY))
+			break;
+		if (bench_wait() & RF24_IRQ_TXFAILED)
+			stalls++;  // Clearing MAX_RT lets the chip retry the head payload
+	}
+	result->stream_us = tx_bench_clock() - start;
+	result->stream_stalls = stalls;
+	msprf24_standby();
+	flush_tx();
+
+	// Streaming NOACK: no ACK turnaround or ARD, TX_DS as soon as a packet is out
+	sent = 0;
+	start = tx_bench_clock();
+	msprf24_stream_tx();
+	while (1) {
+		while (sent < TX_BENCH_PACKETS && !(msprf24_queue_state() & RF24_QUEUE_TXFULL)) {
+			bench_fill();
+			w_tx_payload_noack(32, bench_buf);
+			sent++;
+		}
+		if (sent == TX_BENCH_PACKETS && (msprf24_queue_state() & RF24_QUEUE_TXEMPTY))
+			break;
+		bench_wait();
+	}
+	result->noack_us = tx_bench_clock() - start;
+	msprf24_standby();
+
+	tx_bench_clock_stop();
+}
+
+// Timer1_A overflow extends the microsecond clock
+#ifdef __GNUC__
+__attribute__((interrupt(TIMER1_A1_VECTOR)))
+void T1A1_BENCH (void) {
+#else
+#pragma vector = TIMER1_A1_VECTOR
+__interrupt void T1A1_BENCH(void) {
+#endif
+	if (TA1IV == TA1IV_TAIFG)
+		bench_hi++;
+}
+
+#endif
@@ -0,0 +1,32 @@
+/*
+ * tx_bench.h
+ *
+ * Air throughput of the per-packet PTX path (w_tx_payload + msprf24_activate_tx,
+ * Standby-I between packets) against msprf24_stream_tx() keeping the TX FIFO full,
+ * with and without auto-ACK.  Build with TX_BENCHMARK defined in nrf_userconfig.h.
+ */
+
+#ifndef TX_BENCH_H_
+#define TX_BENCH_H_
+
+#include <stdint.h>
+
+#define TX_BENCH_PACKETS	32		// 32-byte payloads per run
+#define TX_BENCH_STALLS		8		// MAX_RT per run before giving up (no PRX?)
+
+typedef struct {
+	uint32_t packet_us;		// per-packet path, all TX_BENCH_PACKETS ACKed
+	uint32_t stream_us;		// streaming path
+	uint32_t noack_us;		// streaming NOACK payloads, what bulk_send() builds on
+	uint8_t packet_stalls;	// MAX_RT seen (payload retried)
+	uint8_t stream_stalls;
+} TX_BENCH_RESULT;
+
+void tx_bench_run(TX_BENCH_RESULT *result);
+
+// Free running microsecond clock on Timer1_A, for timing transfers outside tx_bench_run()
+void tx_bench_clock_start();
+uint32_t tx_bench_clock();
+void tx_bench_clock_stop();
+
+#endif /* TX_BENCH_H_ */
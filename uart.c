@@ -8,93 +8,269 @@
 #include <msp430.h>
 #include "uart.h"
 #include "events.h"
+#include "interrupts.h"
+#include "msp430_spi.h"
+#include "ring.h"
+#include "prof.h"
+#include "trace.h"
 #include <stdint.h>
-#include <stdio.h>
 #include <stdlib.h>
-#include <stdarg.h>
 #include <string.h>
 
 #if !defined(__MSP430_HAS_USCI__)
 #error "This code written for the msp430g2553"
 #endif
 
-unsigned long SMCLK_HZ = 8000000;			// SMCLK frequency in Hz
+// Rates uart_set_baud() is used with, fastest first; indices are what negotiation talks in
+const uint32_t uart_rates[UART_RATES] = {
+	1000000, 921600, 460800, 230400, 115200, 57600, 38400, 19200, 9600
+};
 
-unsigned long baud_rate_20_bits;		// Bit rate divisor
-unsigned int count;
+#define BAUD_IDLE		0
+#define BAUD_ZERO		1		// one 0x00 seen
+#define BAUD_ZEROS		2		// two in a row, UART_BAUD_REQ may follow
+#define BAUD_INDEX		3		// UART_BAUD_REQ seen, rate index next
+#define BAUD_CONFIRM	4		// switched, waiting for the host's UART_SYNC
 
-uint16_t tail = 0;
-uint16_t size = 0;
-char txbuffer[128];
+// Start the TX ISR; with UART_SLEEPS SMCLK is held until uart_tx_idle()
+#ifdef UART_SLEEPS
+#define TX_START()	do { sched_hold(SCHED_SMCLK_UART); EN_TXIE; } while (0)
+#else
+#define TX_START()	EN_TXIE
+#endif
+static uint8_t baud_state = BAUD_IDLE;
+static uint8_t baud_since;		// low byte of tics at the switch
 
-void uart_init() {
-	memset(txbuffer, 0, sizeof(txbuffer));
+/* TX: main loop produces, USCI0TX_ISR consumes.  RX: USCI0RX_ISR produces, main loop
+ * (UART_RX_EVENT) consumes.  Nothing else may touch either ring, see ring.h.
+ */
+static uint8_t tx_storage[TXBUFSIZE];
+static uint8_t rx_storage[RXBUFSIZE];
+RING uart_tx = RING_INIT(tx_storage);
+RING uart_rx = RING_INIT(rx_storage);
 
+static const uint8_t *tx_packet;		// Sent in place by the TX ISR, see uart_tx_packet()
+static volatile uint8_t tx_packet_len = 0;
+
+void uart_init() {
 	// Configure P1.1 and P1.2 as UART controlled pins
 	P1DIR &= ~(BIT1 | BIT2);                  // Revert to default to GPIO input
 	P1SEL = BIT1 | BIT2;                            // P1.1=RXD, P1.2=TXD
 	P1SEL2 = BIT1 | BIT2;                           // P1.1=RXD, P1.2=TXD
-	// Configure USCI UART for BPS (9600)
-#if BPS == 57600
-	UCA0CTL1 = UCSWRST;
-	UCA0CTL0 = UCSPB;
-	UCA0BR0 = 8;
-	UCA0BR1 = 0;
-	UCA0MCTL = 11 << 4 | 0 << 1 | UCOS16;
-	UCA0CTL1 = UCSSEL_2;
-#else
-	baud_rate_20_bits = (SMCLK_HZ + (BPS >> 1)) / BPS;
+#ifndef UART_SLEEPS
+	sched_hold(SCHED_SMCLK_UART);  // BRCLK, and RX must work in sleep
+#endif
+	uart_set_baud(BPS);
+}
+
+/* Divisor N = SMCLK_HZ / bps.  Above UART_OS16_MIN: oversampling, UCBR = N / 16 and
+ * UCBRF = the remainder in 16ths.  Below it the 16x clock would be too coarse, so
+ * low-frequency mode, UCBR = N and UCBRS = the fraction in 8ths (1Mbaud: N = 8).
+ * Waits for anything still being sent, it would be garbled by the change.
+ */
+void uart_set_baud(uint32_t bps) {
+	uint16_t n;
+
+	while (ring_count(&uart_tx) || tx_packet_len || (UCA0STAT & UCBUSY))
+		;
 	UCA0CTL1 = UCSWRST;             // Hold USCI in reset to allow configuration
 	UCA0CTL0 = UCSPB;// No parity, LSB first, 8 bits, one stop bit, UART (async)
-	UCA0BR1 = (baud_rate_20_bits >> 12) & 0xFF;// High byte of whole divisor
-	UCA0BR0 = (baud_rate_20_bits >> 4) & 0xFF;// Low byte of whole divisor
-	UCA0MCTL = ((baud_rate_20_bits << 4) & 0xF0) | UCOS16;// Fractional divisor, over sampling mode
+	if (SMCLK_HZ / bps >= UART_OS16_MIN) {
+		n = (SMCLK_HZ + bps / 2) / bps;
+		UCA0BR1 = n >> 12;// High byte of whole divisor
+		UCA0BR0 = n >> 4;// Low byte of whole divisor
+		UCA0MCTL = ((n << 4) & 0xF0) | UCOS16;// Fractional divisor, over sampling mode
+	} else {
+		n = (SMCLK_HZ * 8 + bps / 2) / bps;
+		UCA0BR1 = 0;
+		UCA0BR0 = n >> 3;
+		UCA0MCTL = (n & 0x07) << 1;// Second stage modulation, no oversampling
+	}
 	UCA0CTL1 = UCSSEL_2;// Use SMCLK for bit rate generator, then release reset
+	IE2 |= UCA0RXIE; // enable rx interrupt
+}
+
+/* Auto-detect the host's rate from a UART_SYNC byte (0x55): the start bit and 01010101
+ * sent LSB first alternate every bit, so from the start bit's falling edge to the stop
+ * bit's rising edge is 9 bit times.  P1.1 is switched from UCA0RXD to Timer0_A CCI0A
+ * for the measurement.  CCR0 always holds the latest edge, so edges the polling loop
+ * misses at high rates don't matter; the byte is over once the line has been quiet
+ * for twice as long as it has taken so far.  Waits up to about timeout seconds, returns
+ * the rate (now in use) or 0 if nothing matching uart_rates[] came.  Not in TICKLESS
+ * builds, Timer0_A keeps the time there.
+ */
+#ifndef TICKLESS
+uint32_t find_baud_rate(uint8_t timeout) {
+	uint16_t start, last, waits = 0, span;
+	uint32_t bps = 0;
+	uint8_t i;
 
+	P1SEL2 &= ~BIT1;  // P1.1 -> TA0.CCI0A
+	TA0CCTL0 = CM_3 | CCIS_0 | SCS | CAP;  // Both edges
+	TA0CTL = TASSEL_2 | MC_2 | TACLR;  // SMCLK, continuous
+	while (!(TA0CCTL0 & CCIFG)) {
+		if (TA0CTL & TAIFG) {  // 65536 SMCLK ticks, ~122 per second
+			TA0CTL &= ~TAIFG;
+			if (++waits >= (uint16_t) timeout * (SMCLK_HZ >> 16))
+				goto done;
+		}
+	}
+	start = last = TA0CCR0;
+	TA0CCTL0 &= ~(CCIFG | COV);
+	while ((uint16_t)(TA0R - last) <= 2 * (uint16_t)(last - start) || last == start) {
+		if (TA0CCTL0 & CCIFG) {
+			last = TA0CCR0;
+			TA0CCTL0 &= ~(CCIFG | COV);
+		}
+		if ((uint16_t)(TA0R - start) > 0x8000)
+			goto done;  // Too slow for the table, or noise
+	}
+	span = last - start;
+	for (i = 0; i < UART_RATES; i++) {
+		// 9 bit times at this rate, within ~3%
+		if ((uint32_t) span * uart_rates[i] * 32 >= SMCLK_HZ * 9 * 31
+				&& (uint32_t) span * uart_rates[i] * 32 <= SMCLK_HZ * 9 * 33) {
+			bps = uart_rates[i];
+			break;
+		}
+	}
+done:
+	TA0CTL = MC_0;
+	TA0CCTL0 = 0;
+	P1SEL2 |= BIT1;  // Back to UCA0RXD
+	if (bps)
+		uart_set_baud(bps);
+	return bps;
+}
 #endif
 
-	IE2 |= UCA0RXIE; // enable rx interrupt (echoing)
+/* Negotiation byte filter, see UART_BAUD_REQ (and UART_PROF_REQ, UART_TRACE_REQ).  Returns 1 if c was
+ * part of it and is not data.  Blocks while the answer goes out at the old rate.
+ */
+static uint8_t uart_baud_rx(uint8_t c) {
+	if (baud_state == BAUD_INDEX) {
+		if (c >= UART_RATES)
+			c = UART_RATES - 1;
+		putchar(UART_BAUD_REQ);
+		putchar(c);
+		uart_set_baud(uart_rates[c]);
+		baud_state = BAUD_CONFIRM;
+		baud_since = tics;
+		return 1;
+	}
+	if (baud_state == BAUD_CONFIRM) {
+		baud_state = BAUD_IDLE;
+		if (c == UART_SYNC)
+			putchar(UART_SYNC);  // Both ends agree
+		else
+			uart_set_baud(BPS);  // Garbled, the host can't do this rate after all
+		return 1;
+	}
+	if (c == UART_BAUD_REQ && baud_state == BAUD_ZEROS) {
+		baud_state = BAUD_INDEX;
+		return 1;
+	}
+#ifdef PROFILE
+	if (c == UART_PROF_REQ && baud_state == BAUD_ZEROS) {
+		baud_state = BAUD_IDLE;
+		prof_dump();
+		return 1;
+	}
+#endif
+#ifdef TRACE_ENABLE
+	if (c == UART_TRACE_REQ && baud_state == BAUD_ZEROS) {
+		baud_state = BAUD_IDLE;
+		trace_dump();
+		return 1;
+	}
+#endif
+	if (c)
+		baud_state = BAUD_IDLE;
+	else if (baud_state != BAUD_ZEROS)
+		baud_state++;
+	return 0;  // The zeros are data as well, to a COBS decoder they are just frame ends
+}
 
+// Once per ping period: give up on a rate switch the host never confirmed
+void uart_tick() {
+	if (baud_state == BAUD_CONFIRM && (uint8_t)(tics - baud_since) >= UART_BAUD_CONFIRM) {
+		baud_state = BAUD_IDLE;
+		uart_set_baud(BPS);
+	}
 }
 
 //------------------------------------------------------------------------------
 // Inserts char into UART transmit buffer.  Returns 1 if succesful, returns 0 if
-// byte overwritten (buffer full)
+// the buffer was full and the byte dropped (counted in uart_tx.overflows)
 int putchar(int c) {
-	uint16_t head = (tail + size) & ~TXBUFSIZE;
-	if (++size < TXBUFSIZE) {
-		txbuffer[head] = c;
-		head = (head + 1) & ~TXBUFSIZE;
-		head = 1;
-	} else {
-		size--;
-		txbuffer[head] = c;
-		tail = (tail + 1) & ~TXBUFSIZE;
-		head = (head + 1) & ~TXBUFSIZE;
-		head = 0;
+	if (!ring_put(&uart_tx, c))
+		return 0;
+	TX_START();
+	return 1;
+}
+
+// Bytes putchar()/print_x() can take before they start dropping
+uint8_t uart_tx_room() {
+	return ring_room(&uart_tx);
+}
+
+// Received bytes less rate negotiation, up to len of them; returns how many
+uint8_t uart_read(uint8_t *data, uint8_t len) {
+	uint8_t n = 0, c;
+
+	while (n < len && ring_get(&uart_rx, &c)) {
+		if (!uart_baud_rx(c))
+			data[n++] = c;
 	}
-	EN_TXIE;
+	return n;
+}
+
+/* Hand len bytes to the TX ISR, which sends them from where they are instead of copying
+ * them into txbuffer.  Only taken once txbuffer is empty so output stays in order; the
+ * memory has to stay put until uart_tx_busy() clears, UART_TX_EVENT is posted then.
+ * Returns 0 if not taken, UART_TX_EVENT is posted when it's worth trying again.
+ */
+uint8_t uart_tx_packet(const uint8_t *data, uint8_t len) {
+	if (ring_count(&uart_tx) || tx_packet_len)
+		return 0;
+	tx_packet = data;
+	tx_packet_len = len;
+	TX_START();
+	return 1;
+}
+
+uint8_t uart_tx_busy() {
+	return tx_packet_len != 0;
+}
 
-	return head;
+// UART_SLEEPS: SMCLK may stop once the last byte has left the shift register
+void uart_tx_idle() {
+#ifdef UART_SLEEPS
+	if (ring_count(&uart_tx) || tx_packet_len || !(sched_keep & SCHED_SMCLK_UART))
+		return;
+	while (UCA0STAT & UCBUSY)
+		;
+	sched_release(SCHED_SMCLK_UART);
+#endif
 }
 
 //------------------------------------------------------------------------------
 int getchar(void) {
-	while (!(IFG2 & UCA0RXIFG))
+	uint8_t c;
+
+	while (!ring_get(&uart_rx, &c))
 		;
-	IFG2 &= ~UCA0RXIFG;
-	return UCA0RXBUF;
+	return c;
 }
 
 //------------------------------------------------------------------------------
 void print(const char *s) {
-	while (*s)
-		putchar(*s++);
+	print_x(s, strlen(s));
 }
 
 void print_x(const char *s, uint8_t size) {
-	while (size--)
-		putchar(*s++);
+	if (ring_write(&uart_tx, (const uint8_t *)s, size))
+		TX_START();
 }
 
 //------------------------------------------------------------------------------
@@ -106,19 +282,48 @@ void printx(const uint8_t c) {
 
 #pragma vector=USCIAB0TX_VECTOR
 __interrupt void USCI0TX_ISR(void) {
-	if (size == 0) {
+	uint8_t c;
+
+
+	if (tx_packet_len) {
+		UCA0TXBUF = *tx_packet++;
+		if (--tx_packet_len == 0) {
+			TRACE_ISR(TRACE_UART_TX, 0);
+			sched_post_isr(UART_TX_EVENT);  // Packet's memory can go back
+			__bic_SR_register_on_exit(LPM4_bits);
+		}
+		return;
+	}
+	if (!ring_get(&uart_tx, &c)) {
 		DEN_TXIE;
 		return;
 	}
-	UCA0TXBUF = txbuffer[tail];
-	tail = (tail + 1) & ~TXBUFSIZE;
-	if (--size == 0)
+	UCA0TXBUF = c;
+	if (!ring_count(&uart_tx)) {
 		DEN_TXIE;
+		TRACE_ISR(TRACE_UART_TX, 1);
+		sched_post_isr(UART_TX_EVENT);  // Room again for queued radio packets
+		__bic_SR_register_on_exit(LPM4_bits);
+	}
 }
 
-/*  Echo    back    RXed    character,  confirm TX  buffer  is  ready   first   */
+// Received bytes go to uart_rx for the main loop (UART_RX_EVENT)
 #pragma vector=USCIAB0RX_VECTOR
 __interrupt void USCI0RX_ISR(void) {
-	putchar(UCA0RXBUF);
+	uint8_t c;
+
+#ifdef SPI_ASYNC
+	// USCI_A0 and USCI_B0 share this vector; async SPI transfers run from UCB0RXIFG
+	if ((IE2 & UCB0RXIE) && (IFG2 & UCB0RXIFG)) {
+		if (spi_async_isr())
+			__bic_SR_register_on_exit(LPM4_bits);
+		return;
+	}
+#endif
+	c = UCA0RXBUF;
+	TRACE_ISR(TRACE_UART_RX, c);
+	ring_put(&uart_rx, c);  // Dropped and counted if the main loop is behind
+	sched_post_isr(UART_RX_EVENT);
+	__bic_SR_register_on_exit(LPM4_bits);
 }
 
@@ -5,15 +5,8 @@
  *      Author: bsnga
  */
 #include "stdint.h"
-
-#define TERMINAL print
-#define TERMINAL1(f,x) sprintf(buffer,f,x);print(buffer);
-#define TERMINAL2(f,x) sprintf(buffer,f,x,x);print(buffer);
-#define TERMINAL3(f,x,y) sprintf(buffer,f,x,y);print(buffer);
-
-#define XTERMINAL1(f,x) sprintf(buffer,"\n\r%d. ",count++);print(buffer);sprintf(buffer,f,x);print(buffer);
-#define XTERMINAL2(f,x) sprintf(buffer,"\n\r%d. ",count++);print(buffer);sprintf(buffer,f,x,x);print(buffer);
-#define XTERMINAL3(f,x,y) sprintf(buffer,"\n\r%d. ",count++);print(buffer);sprintf(buffer,f,x,y);print(buffer);
+#include "ring.h"
+#include "nrf_userconfig.h"
 
 #define EN_TXIE IE2 |= UCA0TXIE
 #define DEN_TXIE IE2 &= ~UCA0TXIE
@@ -22,13 +15,45 @@
 #define		PORTDIR	P1DIR
 #define		PORTOUT	P1OUT
 
-#define BPS 9600
-#define TXBUFSIZE 32
+#define BPS 9600			// Rate after reset, negotiation starts and falls back here
+#define SMCLK_HZ 8000000UL
+#define UART_OS16_MIN 48	// Divisors below this use low-frequency mode, see uart_set_baud()
+#define UART_RATES 9
+
+/* Rate negotiation, driven by the host at BPS: it sends { 0, 0, UART_BAUD_REQ, n } with n
+ * the uart_rates[] index of the fastest rate it can do (two 0x00 in a row never occur in
+ * a COBS stream, so bridge data can't be taken for it).  We answer { UART_BAUD_REQ, n } at
+ * the old rate and switch; the host switches too and sends UART_SYNC, which we echo as
+ * confirmation.  Anything else, or nothing within UART_BAUD_CONFIRM seconds, and we are
+ * back at BPS.  UART_SYNC is also what find_baud_rate() measures.
+ * With PROFILE, { 0, 0, UART_PROF_REQ } has the profile table sent, see prof.h; with
+ * TRACE_ENABLE, { 0, 0, UART_TRACE_REQ } the trace ring, see trace.h.
+ */
+#define UART_BAUD_REQ 0xBA
+#define UART_PROF_REQ 0xB0
+#define UART_TRACE_REQ 0xB1
+#define UART_SYNC 0x55
+#define UART_BAUD_CONFIRM 2
+#define TXBUFSIZE 32		// Ring sizes, powers of two up to 128
+#define RXBUFSIZE 16
 
 //functions
 void uart_init();
-void find_baud_rate();
+void uart_set_baud(uint32_t bps);
+#ifndef TICKLESS
+uint32_t find_baud_rate(uint8_t timeout);
+#endif
+void uart_tick();
+int putchar(int c);
 void print(const char *s);
 void print_x(const char *s, uint8_t size);
+uint8_t uart_tx_room();
+uint8_t uart_read(uint8_t *data, uint8_t len);
+uint8_t uart_tx_packet(const uint8_t *data, uint8_t len);
+uint8_t uart_tx_busy();
+void uart_tx_idle();
 
 //variables
+extern RING uart_tx;	// overflows/high_water are there for tuning TXBUFSIZE/RXBUFSIZE
+extern RING uart_rx;
+extern const uint32_t uart_rates[UART_RATES];